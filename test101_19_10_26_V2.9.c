@@ -0,0 +1,4424 @@
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define SAVE_FILE "savegame.dat"
+#define SAVE_TMP_FILE "savegame.tmp"
+#define JOURNAL_FILE "savegame.jnl"
+#define SAVE_MAGIC 0x32534344u     // "DCS2"
+#define JOURNAL_MAGIC 0x314A4344u  // "DCJ1"
+#define CATALOG_FILE "seeds.idx"
+#define CATALOG_MAGIC 0x31494344u  // "DCI1"
+#define CATALOG_SHOW 10            // matching seeds printed by --find
+#define JOURNAL_BATCH 16           // records per fsync
+#define JOURNAL_TURN_RECORDS (NUM_STATS + 3)  // most one turn writes: move, cleared, item and stats
+#define JOURNAL_COMPACT_EVERY 512  // records before rewriting the snapshot
+#define INPUT_LINE_SIZE 1024
+#define MAP_WIDTH 48               // minimap cells, one per room position
+#define MAP_HEIGHT 11
+#define ROOM_TEXT_SIZE 256         // rendered room description, header to treasure line
+#define SOLVER_EPSILON 1e-9        // solver classes reached less likely than this are dropped
+#define SOLVER_MAX_CLASSES 65536   // and only the most likely ones are kept per room
+#define BOT_MAX_DEPTH 4            // bot lookahead in rooms
+#define BOT_CACHE_SIZE (1 << 16)   // memo entries per bot, power of two
+#define BOT_PATH_CACHE (1 << 10)   // estimate paths per bot, power of two
+#define BOT_EPSILON 1e-6           // fight outcomes less likely than this are skipped by the bot
+#define FIGHT_CACHE_SIZE (1 << 14) // shared fight outcomes in batch runs, power of two
+#define FIGHT_CACHE_STRIPES 64     // locks, each guarding every 64th slot
+#define FIGHT_EPSILON 1e-12        // the fight DP stops when less than this is still fighting
+#define WORLD_PAGE_ROOMS 256       // rooms per copy-on-write page
+#define BALANCE_FILE "balance.txt"
+#define LOOT_MAX_ITEMS 1024
+#define LOOT_BANDS 5               // loot tables, one per 10 rooms; deeper rooms use the last
+#define LOOT_BAND_ROOMS 10
+#define GEAR_SLOTS 64              // equipped items kept apart; more are folded into the base stats
+#define POP_ITEM_HP 20             // item bonuses of the default --population candidate, the
+#define POP_ITEM_STAT 5            // default loot; a lane scales each loot delta by its own bonus
+#define TUNE_BANDS 5               // alive on entering room 10, 20, 30, 40, and wins
+#define TUNE_LAMBDA 12             // balance candidates per generation
+#define TUNE_GENERATIONS 40
+#define TUNE_GAMES 5000            // headless games per candidate
+#define TUNE_MIN_SIGMA 0.02        // smallest step size of the tuner, in log units
+#define MAX_EVENT_HANDLERS 8       // handlers per event type
+#define EVENT_QUEUE_SIZE 8         // events queued in one turn
+#define EVENT_BIT(type) (1u << (type))
+#define INITIATIVE_SCALE 100000    // time between actions at speed 1; speed s acts every SCALE / s
+#define ENCOUNTER_GAMES 1000       // encounters played by --encounter
+#define WHEEL_SLOTS 64             // timer wheel slots per level; level 1 slots span 64 ticks
+#define WHEEL_LEVELS 2
+#define WHEEL_MAX_DELAY (WHEEL_SLOTS * (WHEEL_SLOTS - 1))
+#define STATUS_MAX_EFFECTS 256     // active effects per wheel; more are dropped
+#define ROAM_TICKS 100             // world ticks played by --roam
+#define NOISE_STEP 2               // noise of walking into a room, heard one room further
+#define NOISE_FIGHT 6              // noise of a fight
+#define NOISE_WAKE 3               // a sleeping monster wakes at this noise level
+#define STAT_BINS 256              // histogram bins, one per value; larger values count as the last
+#define BIT_GET(bits, i) (((bits)[(i) >> 6] >> ((i) & 63)) & 1)
+#define BIT_SET(bits, i) ((bits)[(i) >> 6] |= 1ULL << ((i) & 63))
+
+// Structs
+
+typedef enum { GOBLIN, ORC } MonsterType;
+
+typedef struct Monster {
+    int hp, attack, defense, speed, xp;
+    MonsterType type;
+    int count;  // monsters of this kind in the room, more than 1 only with --pack
+} Monster;
+
+typedef enum { EVENT_ENTER, EVENT_FIRST_VISIT, EVENT_COMBAT_START, EVENT_ITEM_PICKUP, EVENT_TREASURE, NUM_EVENTS } EventType;
+
+typedef struct Room {
+    int id;
+    int hasMonster, hasItem, hasTreasure, visited;
+    struct Room* connections[4];
+    Monster* monster;
+    unsigned events;  // EVENT_BIT of every event type this room dispatches
+} Room;
+
+// 16 rounds of 4-bit attack patterns from one 64-bit random word
+typedef struct PatternSource {
+    uint64_t bits;
+    int left;
+} PatternSource;
+
+// Monster stats in room 0 and how much they grow per room
+typedef struct Balance {
+    float hp, attack, defense, speed, xp, growth;
+} Balance;
+
+// One slice of rooms for parallel dungeon generation
+typedef struct GenChunk {
+    Room* rooms;
+    Monster* monsters;  // pooled monster slots, or NULL to malloc each monster
+    int numRooms, first, last;
+    uint64_t seed;
+    const Balance* balance;
+} GenChunk;
+
+typedef void (*ParallelTask)(void*);
+
+// What an item does to the player, added in one step
+typedef struct ItemDelta {
+    int16_t hp, damage, defense, speed;
+} ItemDelta;
+
+// Loot table entry. In a band starting at room r the item weighs weight + perRoom * r,
+// or nothing before minRoom.
+typedef struct LootItem {
+    char icon[16];
+    char name[40];
+    ItemDelta delta;
+    float weight, perRoom;
+    int minRoom;
+} LootItem;
+
+// Alias table of one depth band: column k is item k when the low 32 random bits
+// are below threshold[k], otherwise item alias[k]
+typedef struct LootBand {
+    uint32_t threshold[LOOT_MAX_ITEMS];
+    uint16_t alias[LOOT_MAX_ITEMS];
+    double prob[LOOT_MAX_ITEMS];
+    double meanHp, meanDamage, meanDefense, meanSpeed;
+} LootBand;
+
+// Save journal: compact deltas appended after the last snapshot in savegame.dat
+typedef enum { JOURNAL_MOVE, JOURNAL_ROOM_CLEARED, JOURNAL_ITEM_TAKEN, JOURNAL_STAT } JournalType;
+
+typedef enum { STAT_HP, STAT_DAMAGE, STAT_SPEED, STAT_DEFENSE, STAT_LEVEL, STAT_EXPERIENCE, STAT_EXP_TO_NEXT, NUM_STATS } StatField;
+
+typedef struct JournalRecord {
+    uint8_t type, stat;
+    uint16_t room;
+    int32_t value;
+} JournalRecord;
+
+// Records are written and synced in whole turns, so a crash never keeps half of one
+typedef struct Journal {
+    FILE* file;
+    JournalRecord pending[JOURNAL_BATCH];
+    int numPending, sinceSnapshot;
+    uint32_t generation;
+    uint64_t seed;
+    Room* rooms;
+    int numRooms;
+} Journal;
+
+// Queued commands: one line like "wwddsx" runs all its moves without prompting in between
+typedef struct InputQueue {
+    char line[INPUT_LINE_SIZE];
+    int pos, len;
+    FILE* source;
+    int showPrompts;
+} InputQueue;
+
+// Minimap of visited rooms at the top of the terminal. front is what the terminal
+// shows, back is the next frame; only cells that differ are sent.
+typedef struct Minimap {
+    int enabled, numRooms, originX, originY;
+    int* roomX;
+    int* roomY;
+    char front[MAP_HEIGHT][MAP_WIDTH];
+    char back[MAP_HEIGHT][MAP_WIDTH];
+} Minimap;
+
+// Rendered descriptions per room. key[r] holds the flags and monster HP the text
+// was rendered for, -1 when none, and monster[r] the monster; any other state renders it again.
+typedef struct RoomText {
+    int numRooms;
+    char* text;
+    int* length;
+    int* key;
+    const Monster** monster;
+} RoomText;
+
+typedef enum { MOD_BASE, MOD_LEVEL, NUM_MOD_LAYERS } ModifierLayer;
+
+// Where damage, defense and speed come from: base stats with kill bonuses, level-up
+// bonuses and every equipped item. The player's own fields hold the sum, which is
+// recomputed by playerStats only after something here changed.
+typedef struct Equipment {
+    ItemDelta layers[NUM_MOD_LAYERS];
+    ItemDelta items[GEAR_SLOTS];
+    int numItems, dirty;
+} Equipment;
+
+typedef struct Player {
+    int hp, damage, speed, defense, level, experience, expToNextLevel;
+    Room* currentRoom;
+    Equipment* gear;  // NULL: bonuses are added to the stats directly
+} Player;
+
+typedef enum { TURN_CONTINUE, TURN_WON, TURN_DIED } TurnResult;
+
+typedef struct RoomEvent {
+    EventType type;
+    Room* room;
+    Player* player;
+    int item;  // lootItems index of an ITEM_PICKUP, -1 otherwise
+} RoomEvent;
+
+typedef void (*EventHandler)(const RoomEvent* event);
+
+// Events of one turn, handed to the handlers grouped by type
+typedef struct EventQueue {
+    RoomEvent events[EVENT_QUEUE_SIZE];
+    int count;
+} EventQueue;
+
+// Asked when a monster sleeps: nonzero to try sneaking past it
+typedef int (*SneakPolicy)(Player* player, void* ctx);
+
+// Reused world storage for batch runs: rooms and monsters are reset, never freed between games
+typedef struct WorldPool {
+    Room* rooms;
+    Monster* monsters;
+    int capacity;
+} WorldPool;
+
+typedef enum { HIST_ROUNDS, HIST_DAMAGE_DEALT, HIST_DAMAGE_TAKEN, HIST_DEATH_ROOM, HIST_LEVEL, NUM_HISTS } HistogramType;
+
+// Histograms of one thread; only that thread writes them, they are added up after the run
+typedef struct RunStats {
+    long long counts[NUM_HISTS][STAT_BINS];
+    long long total[NUM_HISTS], sum[NUM_HISTS];
+} RunStats;
+
+// Games [first, last) of a batch run, played by one thread with its own pool
+typedef struct BatchShard {
+    int first, last, numRooms;
+    uint64_t seed;
+    int wins, deaths, botDepth;
+    long long deathRoomSum, botDecisions, botLookups, botHits;
+    WorldPool pool;
+    RunStats stats;
+} BatchShard;
+
+// Win probability of one fight, split by how many hits the player took
+typedef struct CombatOutcome {
+    double win;
+    double unresolved;  // still fighting when combatMarkov stopped
+    int attacks;        // attacks combatMarkov played
+    double q;        // chance the next landed hit is the player's
+    int hitsToKill;
+    int hpLoss;      // HP lost per monster hit
+    int count;       // prob[i]: player wins after taking i hits
+    int capacity;
+    double* prob;
+} CombatOutcome;
+
+// Route solver: the player on entering a room, except HP. The dungeon is a chain and
+// walking back never helps, so every room before this one counts as cleared, and
+// expToNextLevel follows from level.
+typedef struct SolverClass {
+    int damage, defense, speed, level, experience;
+} SolverClass;
+
+// All classes that can enter one room. HP only ever shifts and fight odds don't
+// depend on it, so each class keeps its survival chance as a row indexed by HP,
+// up to the most HP it can have there. reach bounds how likely any route gets
+// there (both sides of a choice count); classes that always fighting can reach
+// are never dropped, so sneaking can only improve the result.
+typedef struct SolverLayer {
+    SolverClass* classes;
+    double* reach;
+    int* hpMax;
+    char* fought;
+    size_t* offset;  // start of each class's row in value
+    double* value;
+    int count, capacity, maxHp;
+    int* index;      // hash slot -> class number + 1
+    int indexSize;
+} SolverLayer;
+
+typedef struct Solver {
+    Room* rooms;
+    int numRooms, allowSneak;
+    SolverLayer* layers;
+} Solver;
+
+// One thread's slice of a layer in the backward pass, with its scratch rows
+typedef struct SolverTask {
+    Solver* solver;
+    int room, first, last;
+    CombatOutcome outcome;
+    double* after;  // afterSize entries, grown to the largest HP after a kill
+    double* fight;
+    int afterSize;
+} SolverTask;
+
+// Bot memo: the player (stats as in the solver plus HP) entering a room, looked ahead depth rooms
+typedef struct BotKey {
+    SolverClass c;
+    int hp, room, depth;
+} BotKey;
+
+typedef struct BotEntry {
+    BotKey key;
+    double value;
+    uint32_t stamp;  // entries from an earlier game are stale
+} BotEntry;
+
+// What botEstimate needs from the rooms ahead of a class: for every fight the HP
+// margin without the player's own HP, and 1 / standard deviation of the damage
+typedef struct BotPath {
+    SolverClass c;
+    int room, fights;
+    uint32_t stamp;
+    double* margin;
+    double* scale;
+} BotPath;
+
+// Expectimax player for sleeping monsters; one per thread
+typedef struct Bot {
+    Room* rooms;
+    int numRooms, depth, pathCapacity;
+    BotEntry* cache;
+    BotPath* paths;
+    uint32_t stamp;
+    long long decisions, lookups, hits;
+    CombatOutcome outcome[BOT_MAX_DEPTH + 1];  // one per lookahead level, 0 for the estimate
+} Bot;
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION Mutex;
+#else
+typedef pthread_mutex_t Mutex;
+#endif
+
+// Everything a fight depends on except player HP: that only decides after how many
+// hits the player is dead, so one outcome serves every HP up to the one it was made for.
+typedef struct FightKey {
+    int damage, defense, speed;
+    int monsterHp, monsterAttack, monsterDefense, monsterSpeed;
+} FightKey;
+
+typedef struct FightEntry {
+    FightKey key;
+    int used;
+    CombatOutcome outcome;  // prob[i] summed: chance to win after at most i hits
+} FightEntry;
+
+// Shared by the batch threads: fixed size, direct mapped, slot i guarded by lock i % stripes
+typedef struct FightCache {
+    FightEntry* entries;
+    Mutex locks[FIGHT_CACHE_STRIPES];
+    long long hits[FIGHT_CACHE_STRIPES], misses[FIGHT_CACHE_STRIPES];
+} FightCache;
+
+// Room of a copy-on-write world: links are room numbers (-1 for none) and the
+// monster is stored inline, so a page can be copied without fixing pointers
+typedef struct WorldRoom {
+    int hasMonster, hasItem, hasTreasure, visited;
+    int links[4];
+    Monster monster;
+    unsigned events;
+} WorldRoom;
+
+typedef struct WorldPage {
+    int refs;
+    WorldRoom rooms[WORLD_PAGE_ROOMS];
+} WorldPage;
+
+typedef struct WorldTable {
+    int refs, numPages;
+    WorldPage* pages[];
+} WorldTable;
+
+// A world shares its page table and pages with its clones until it writes to them.
+// Refcounts are plain ints: a world and its clones belong to one thread.
+typedef struct World {
+    WorldTable* table;
+    int numRooms;
+    long long pagesCopied, bytesCopied;
+} World;
+
+// Candidate players as structure-of-arrays, one lane per (candidate, trial):
+// lane = candidate * trials + trial. Item bonuses are per lane too so the
+// update loops need no lookups.
+typedef struct Population {
+    int count, candidates, trials;
+    int* hp;
+    int* damage;
+    int* speed;
+    int* defense;
+    int* level;
+    int* experience;
+    int* expToNextLevel;
+    int* itemHp;
+    int* itemDamage;
+    int* itemDefense;
+    int* itemSpeed;
+    int* alive;
+    int* itemRoll;  // scratch
+} Population;
+
+// Candidates [first, last) of a population run; survivors[c * (numRooms + 1) + r]
+// counts the trials of candidate c alive on entering room r, the last column the wins.
+// Lane i draws from its own counter-based stream seed + i, whatever shard it is in.
+typedef struct PopulationShard {
+    Population* pop;
+    Room* rooms;
+    int numRooms, first, last;
+    uint64_t seed;
+    int* survivors;
+} PopulationShard;
+
+// One balance candidate of the tuner and how close it got to the targets
+typedef struct TuneTask {
+    Balance balance;
+    double logValues[6];
+    const double* targets;
+    int numTargets, games;
+    uint64_t seed;
+    double alive[TUNE_BANDS];
+    double error;
+} TuneTask;
+
+// Noise per room, fading one level per move. level[r] was set at turn stamp[r], so
+// nothing has to be touched when turns pass. The bitsets are BFS scratch space.
+typedef struct NoiseField {
+    Room* rooms;
+    int numRooms, words, turn;
+    int* level;
+    int* stamp;
+    uint64_t* seen;
+    uint64_t* frontier;
+    uint64_t* next;
+    long long emits, roomsReached;
+} NoiseField;
+
+typedef enum { EFFECT_POISON, EFFECT_STUN, EFFECT_REGEN } EffectType;
+
+// Poison and regen change hp every period ticks, left times; a stun holds
+// *stunned up until it runs out
+typedef struct StatusEffect {
+    EffectType type;
+    const char* target;  // name for messages
+    int* hp;
+    int* stunned;
+    int amount, period, left, level, slot;
+    unsigned long long due;
+    int prev, next;  // slot list, or the free list in next
+} StatusEffect;
+
+// Two-level timer wheel: ticks are combat rounds and moves. Effects due within
+// WHEEL_SLOTS ticks sit in level 0, later ones in level 1 until their block starts.
+typedef struct StatusWheel {
+    StatusEffect effects[STATUS_MAX_EFFECTS];
+    int slots[WHEEL_LEVELS][WHEEL_SLOTS];
+    int freeList, numActive, playerStunned;
+    unsigned long long now;
+} StatusWheel;
+
+// One side of an encounter is the player with allies (0), the other the monsters (1)
+typedef struct Combatant {
+    const char* name;
+    int number, hp, attack, defense, speed, side;
+    int slot;  // position in its side's alive list, -1 once dead
+    long long nextTime;
+} Combatant;
+
+// Many-actor fight. Every actor has one heap entry keyed by the time of its next
+// action, so each action is a pop and a push; dead actors are dropped when popped.
+typedef struct Encounter {
+    Combatant* actors;
+    int numActors, capacity, heapSize;
+    int* heap;
+    int* alive[2];  // living actors per side, for random targets in O(1)
+    int numAlive[2];
+    int leader;  // side 0 loses when this actor falls, -1 if only the last one counts
+    long long actions;
+} Encounter;
+
+typedef enum { AI_RESTING, AI_WANDERING } AiState;
+
+// Components of roaming monsters as packed arrays, one index per entity
+typedef struct MonsterColumns {
+    int* room;
+    int* hp;
+    int* attack;
+    int* defense;
+    int* speed;
+    int* timer;  // ticks left to rest
+    uint32_t* id;
+    uint8_t* state;
+} MonsterColumns;
+
+// Entity store kept sorted by room: the monsters in room r are first[r] to
+// first[r + 1] - 1 of the current columns, so a chunk of rooms is one slice.
+// A tick writes the re-sorted entities into the other set of columns.
+typedef struct MonsterStore {
+    int count, numRooms, current;
+    MonsterColumns columns[2];
+    int* first;
+    int* dest;        // room each entity moves to this tick
+    int (*exits)[4];  // connected room numbers, packed to the front
+    uint8_t* numExits;
+    uint64_t seed;
+} MonsterStore;
+
+// Rooms [firstRoom, lastRoom) of a tick. counts starts as how many of the chunk's
+// entities go to each room and becomes where the chunk writes them.
+typedef struct RoamChunk {
+    MonsterStore* store;
+    int firstRoom, lastRoom, from, to;
+    int* counts;
+    uint64_t tick;
+    long long moved;
+} RoamChunk;
+
+// Monsters of the played dungeon roaming with --wander 1, one entity per monster
+// outside the treasure room. The store only moves them: entity e stays the Monster
+// owner[e], so the fights and the room text keep using that Monster.
+typedef struct Wander {
+    MonsterStore store;
+    RoamChunk chunk;
+    Room* rooms;
+    Monster** owner;  // Monster of each entity id
+    Monster** home;   // room->monster as generated, put back before freeDungeon
+    uint64_t tick;
+} Wander;
+
+typedef struct HpEntry {
+    int room, hp;
+} HpEntry;
+
+// Seed catalog record: bit i is set when room i has a monster / an item.
+// The seed itself is implied by the position in the index.
+typedef struct SeedSummary {
+    uint64_t monsters, items;
+} SeedSummary;
+
+// Designer query: no monsters in the first freeRooms rooms, at least minItems
+// items and at most maxMonsters monsters
+typedef struct SeedQuery {
+    int freeRooms, minItems, maxMonsters;
+} SeedQuery;
+
+// One slice of seeds for building the catalog or searching without one
+typedef struct SeedChunk {
+    const SeedQuery* query;
+    SeedSummary* summaries;
+    uint64_t first;
+    int count, numRooms, numFound;
+    uint64_t found[CATALOG_SHOW];
+    long long roomsRolled;
+} SeedChunk;
+
+// One player on a shared, read-only dungeon template. Only what the player changed
+// is stored: a bit per room for cleared monsters, taken items and visited rooms,
+// and the HP of monsters that were hurt but not killed.
+typedef struct Session {
+    uint64_t* cleared;  // cleared, taken and visited share one allocation
+    uint64_t* taken;
+    uint64_t* visited;
+    HpEntry* hurt;
+    int numHurt, hurtCapacity;
+    Player player;
+    int room;
+    uint64_t rng;
+    TurnResult result;
+} Session;
+
+static const size_t statOffset[NUM_STATS] = {
+    offsetof(Player, hp), offsetof(Player, damage), offsetof(Player, speed), offsetof(Player, defense),
+    offsetof(Player, level), offsetof(Player, experience), offsetof(Player, expToNextLevel)
+};
+
+// Monster balance, replaced by --balance
+static Balance balance = {30, 10, 10, 10, 10, 0.1f};
+static const char* balanceNames[6] = {"hp", "attack", "defense", "speed", "xp", "growth"};
+static const size_t balanceOffset[6] = {
+    offsetof(Balance, hp), offsetof(Balance, attack), offsetof(Balance, defense),
+    offsetof(Balance, speed), offsetof(Balance, xp), offsetof(Balance, growth)
+};
+// Box the tuner stays in: every stat at least 1 in room 0 and attack at least the
+// player's starting defense, so hits aren't all the 1-point minimum; growth 0.1% to 100% per room
+static const float balanceMin[6] = {1, 10, 1, 1, 1, 0.001f};
+static const float balanceMax[6] = {1000, 1000, 1000, 1000, 1000, 1};
+
+// Dodge chance is 5% per speed point difference, capped at 50% (10 points).
+// Stored as 32-bit thresholds so a dodge is one integer compare on raw random bits.
+#define MAX_DODGE_DIFF 10
+#define DODGE_THRESHOLD(d) (uint32_t)(((uint64_t)(d) << 32) / 20)
+static const uint32_t dodgeThreshold[MAX_DODGE_DIFF + 1] = {
+    DODGE_THRESHOLD(0), DODGE_THRESHOLD(1), DODGE_THRESHOLD(2), DODGE_THRESHOLD(3),
+    DODGE_THRESHOLD(4), DODGE_THRESHOLD(5), DODGE_THRESHOLD(6), DODGE_THRESHOLD(7),
+    DODGE_THRESHOLD(8), DODGE_THRESHOLD(9), DODGE_THRESHOLD(10)
+};
+
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
+// Random state (splitmix64), same sequence on every platform unlike rand().
+// One per thread so batch games don't share a sequence.
+static THREAD_LOCAL uint64_t rngState;
+
+// Game output, muted for headless batch runs
+static int quietMode = 0;
+#define LOG(...) do { if (!quietMode) printf(__VA_ARGS__); } while (0)
+
+// Set during batch runs: fights are drawn from cached outcomes instead of played out
+static FightCache* fightCache = NULL;
+
+// The running thread's own shard during batch runs, NULL otherwise
+static THREAD_LOCAL RunStats* runStats = NULL;
+
+// Loot table and its alias tables, built at startup and only read afterwards
+static LootItem defaultLoot[] = {
+    {"❤️", "+20 HP", {20, 0, 0, 0}, 1, 0, 0},
+    {"🗡️", "+5 Damage", {0, 5, 0, 0}, 1, 0, 0},
+    {"🛡️", "+5 Defense", {0, 0, 5, 0}, 1, 0, 0},
+    {"⚡", "+5 Speed", {0, 0, 0, 5}, 1, 0, 0},
+};
+static LootItem* lootItems = defaultLoot;
+static int numLootItems = 4;
+static LootBand lootBands[LOOT_BANDS];
+
+// Status effects of the running thread's game, NULL when --effects is off
+static int useEffects = 0;
+static THREAD_LOCAL StatusWheel* statusWheel = NULL;
+
+// Noise of the running thread's game, NULL when --noise is off
+static int useNoise = 0;
+static THREAD_LOCAL NoiseField* noiseField = NULL;
+
+// Roaming monsters of the played dungeon, NULL unless --wander 1
+static THREAD_LOCAL Wander* wander = NULL;
+
+// --pack N puts 1 to N monsters in a monster room and --allies A brings A allies
+// into every fight; those fights run on the encounter heap. The solver and the bot
+// still count one monster per room.
+static int packSize = 1;
+static int packAllies = 0;
+
+// Room event handlers, registered at startup and only read afterwards
+static EventHandler eventHandlers[NUM_EVENTS][MAX_EVENT_HANDLERS];
+static int numEventHandlers[NUM_EVENTS];
+
+// Per-room random streams used by generateDungeonSeeded, and per lane by the population run
+enum { STREAM_MONSTER, STREAM_ITEM, STREAM_LINK, STREAM_FIGHT, STREAM_PICKUP, STREAM_PACK };
+
+// Function declarations
+Room* generateDungeonSeeded(int numRooms, uint64_t seed, int numThreads);
+void generateRoomsChunk(void* chunk);
+void displayRoom(RoomText* cache, Room* room);
+void roomTextInit(RoomText* cache, int numRooms);
+void roomTextFree(RoomText* cache);
+TurnResult resolveRoom(Player* player, SneakPolicy sneak, void* ctx);
+int askSneak(Player* player, void* input);
+Room* forwardRoom(Room* room);
+TurnResult playHeadless(Player* player, Room* rooms, SneakPolicy sneak, void* ctx);
+TurnResult moveTick(Player* player, int room);
+unsigned roomEvents(int hasMonster);
+void poolInit(WorldPool* pool, int capacity);
+Room* poolGenerateDungeon(WorldPool* pool, int numRooms, uint64_t seed, const Balance* b);
+void poolFree(WorldPool* pool);
+void runBatch(int numGames, uint64_t seed, int numThreads, int botDepth, int useFightCache);
+void batchShardRun(void* shard);
+void bitwiseCombat(Player* player);
+void cachedCombat(Player* player);
+void encounterCombat(Player* player);
+int packFight(const Room* room);
+void defeatMonster(Player* player, Monster* m);
+int getItem(Player* player, int room);
+void itemApply(Player* player, const ItemDelta* delta);
+void playerModify(Player* player, ModifierLayer layer, const ItemDelta* delta);
+void playerStats(Player* player);
+void gearInit(Equipment* gear, Player* player);
+int lootBand(int room);
+int lootBuild(void);
+int loadLoot(const char* file);
+void levelUp(Player* player);
+void displayPlayerStats(Player* player);
+void saveGame(Player* player, Journal* journal);
+int loadGame(Player* player, Journal* journal);
+int readSaveSeed(uint64_t* seed);
+void deleteSave(Journal* journal);
+void journalAppend(Journal* journal, int type, int stat, int room, int value);
+void journalStats(Journal* journal, Player* logged, Player* player);
+void journalFlush(Journal* journal);
+void journalClose(Journal* journal);
+void syncFile(FILE* f);
+void inputInit(InputQueue* in, FILE* source, const char* commands);
+void inputQueue(InputQueue* in, const char* commands);
+char readCommand(InputQueue* in, const char* prompt);
+int minimapInit(Minimap* map, Room* rooms, int numRooms);
+void minimapDraw(Minimap* map, Room* rooms, Room* current);
+void minimapClose(Minimap* map);
+void combatOutcome(const Player* player, const Monster* m, CombatOutcome* out);
+void combatMarkov(const Player* player, const Monster* m, double epsilon, CombatOutcome* out);
+void fightRates(const Player* player, const Monster* m, int* playerDmg, int* monsterDmg, double* playerHit, double* monsterHit);
+void showFight(Room* rooms, int numRooms, int room);
+void rollMonster(Monster* m, int room, const Balance* b);
+void worldCreate(World* world, int numRooms, uint64_t seed);
+void worldClone(const World* world, World* clone);
+void worldFree(World* world);
+const WorldRoom* worldRoom(const World* world, int room);
+WorldRoom* worldEdit(World* world, int room);
+TurnResult worldPlay(World* world, Player* player, int* room, int stopRoom);
+void runForks(int numRooms, int numBranches, int forkRoom, uint64_t seed);
+void populationInit(Population* pop, int candidates, int trials);
+void populationFree(Population* pop);
+void populationShardRun(void* shard);
+void runPopulation(int candidates, int trials, uint64_t seed, int numThreads);
+int loadBalance(const char* file, Balance* b);
+void saveBalance(const char* file, const TuneTask* best);
+void tuneEvaluate(void* task);
+int tuneCompare(const void* a, const void* b);
+double tuneClamp(int field, double logValue);
+void runTune(const char* targets, uint64_t seed, int numThreads);
+void sessionInit(Session* session, int numRooms, uint64_t seed);
+void sessionFree(Session* session);
+TurnResult sessionStep(Session* session, Room* dungeon);
+int sessionMonsterHp(const Session* session, int room, int baseHp);
+void sessionHurtMonster(Session* session, int room, int hp);
+void runSessions(int numSessions, uint64_t seed);
+void seedSummarize(uint64_t seed, int numRooms, SeedSummary* out);
+int summaryMatches(const SeedSummary* summary, const SeedQuery* q);
+int seedMatches(uint64_t seed, int numRooms, const SeedQuery* q, long long* roomsRolled);
+int parseSeedQuery(const char* spec, SeedQuery* q);
+void catalogChunkRun(void* chunk);
+void searchChunkRun(void* chunk);
+void buildCatalog(uint64_t first, int count, int numThreads);
+void findSeeds(const char* spec, uint64_t first, int count, int numThreads);
+void encounterInit(Encounter* e, int capacity);
+void encounterFree(Encounter* e);
+int encounterAdd(Encounter* e, const char* name, int number, int hp, int attack, int defense, int speed, int side);
+int encounterBefore(const Encounter* e, int a, int b);
+void initiativePush(Encounter* e, int actor);
+int initiativePop(Encounter* e);
+int encounterRun(Encounter* e);
+void runEncounters(int numMonsters, int numAllies, int room, uint64_t seed);
+void storeInit(MonsterStore* store, int numRooms, int count, uint64_t seed);
+void storePlace(MonsterStore* store, int e, int room, const Monster* m);
+void storeIndex(MonsterStore* store);
+void storeFree(MonsterStore* store);
+void storeTick(MonsterStore* store, RoamChunk* chunks, int numChunks, uint64_t tick);
+void storeSort(MonsterStore* store, RoamChunk* chunks, int numChunks);
+void roamDecide(void* chunk);
+void roamScatter(void* chunk);
+void runRoam(int count, int numRooms, uint64_t seed, int numThreads);
+void wanderInit(Wander* w, Room* rooms, int numRooms, uint64_t seed);
+void wanderTick(Wander* w);
+void wanderFree(Wander* w);
+void noiseInit(NoiseField* field, Room* rooms, int numRooms);
+void noiseReset(NoiseField* field);
+void noiseFree(NoiseField* field);
+int noiseLevel(const NoiseField* field, int room);
+int noiseEmit(NoiseField* field, int room, int amount);
+void noiseMove(NoiseField* field, int room);
+void wheelInit(StatusWheel* w);
+void wheelPlace(StatusWheel* w, int id);
+void wheelUnlink(StatusWheel* w, int id);
+void wheelTick(StatusWheel* w);
+int effectAdd(StatusWheel* w, EffectType type, const char* target, int* hp, int* stunned, int amount, int period, int count);
+void effectFire(StatusWheel* w, int id);
+void effectRemove(StatusWheel* w, int id);
+void effectCancel(StatusWheel* w, const int* hp);
+void statusOnHit(StatusWheel* w, Player* player, const Monster* m, int hits);
+double solveDungeon(Room* rooms, int numRooms, int allowSneak, int numThreads, long long* numStates);
+void solverExpand(Solver* solver, int room);
+void solverAddItems(Solver* solver, int room, const SolverClass* c, double reach, int hpMax, int fought);
+int solverKill(const SolverClass* c, const Monster* m, SolverClass* out);
+void solverBackwardTask(void* task);
+void solverAfterMonster(SolverTask* task, int room, const SolverClass* c, double* row, int maxHp);
+const double* solverRow(SolverLayer* layer, const SolverClass* c);
+int solverLayerFind(SolverLayer* layer, const SolverClass* c, double reach, int hpMax, int fought);
+void solverLayerPrune(SolverLayer* layer);
+int solverCompareReach(const void* a, const void* b);
+void solverLayerReindex(SolverLayer* layer);
+uint64_t solverClassHash(const SolverClass* c);
+void solverLayerFree(SolverLayer* layer);
+void botInit(Bot* bot, int depth);
+void botStartGame(Bot* bot, Room* rooms, int numRooms);
+void botFree(Bot* bot);
+int botChooseSneak(Player* player, void* bot);
+double botValue(Bot* bot, const SolverClass* c, int hp, int room, int depth);
+double botFight(Bot* bot, const SolverClass* c, int hp, int room, int depth);
+double botAfterMonster(Bot* bot, const SolverClass* c, int hp, int room, int depth);
+double botEstimate(Bot* bot, const SolverClass* c, int hp, int room);
+BotPath* botPath(Bot* bot, const SolverClass* c, int room);
+void fightCacheInit(FightCache* cache);
+void fightCacheFree(FightCache* cache);
+int fightCacheSample(FightCache* cache, const Player* player, const Monster* m, double u);
+void statsAdd(RunStats* stats, int hist, int value);
+void statsMerge(RunStats* into, const RunStats* from);
+int statsQuantile(const RunStats* stats, int hist, double q);
+void statsPrint(const RunStats* stats);
+void mutexInit(Mutex* mutex);
+void mutexLock(Mutex* mutex);
+void mutexUnlock(Mutex* mutex);
+void mutexFree(Mutex* mutex);
+void freeDungeon(Room* rooms, int numRooms);
+int registerEventHandler(EventType type, EventHandler handler);
+void registerDefaultHandlers(void);
+RoomEvent* eventPush(EventQueue* queue, EventType type, Room* room, Player* player);
+void eventDispatch(EventQueue* queue);
+void onFirstVisit(const RoomEvent* event);
+void onCombatStart(const RoomEvent* event);
+void onItemPickup(const RoomEvent* event);
+void onTreasure(const RoomEvent* event);
+void rngSeed(uint64_t seed);
+uint64_t rngNext64(void);
+uint64_t mix64(uint64_t z);
+uint64_t roomRandom(uint64_t seed, int room, int stream);
+void roomLinks(uint64_t seed, int room, int numRooms, int links[4]);
+void runParallel(ParallelTask task, void* args, size_t argSize, int count);
+int dodgeRoll(int speedDiff);
+int nextPattern(PatternSource* src);
+int popcount64(uint64_t x);
+int ctz64(uint64_t x);
+
+int main(int argc, char* argv[]) {
+    uint64_t seed = (uint64_t)time(NULL);
+    int numThreads = 1, seedGiven = 0, batchGames = 0, showMap = 1, solve = 0, botDepth = 0;
+    int useFightCache = 0, fightRoom = -1, worldRooms = 1000000, numBranches = 0, forkRoom = 5;
+    int populationSize = 0, trials = 100, numSessions = 0, catalogSeeds = 0, searchSeeds = 1000000;
+    const char* findSpec = NULL;
+    int encounterMonsters = 0, numAllies = 0, encounterRoom = 5, roamers = 0, useWander = 0;
+    const char* tuneTargets = NULL;
+    const char* commands = NULL;
+    FILE* script = stdin;
+    registerDefaultHandlers();
+    for (int i = 1; i + 1 < argc; i++) {
+        if (strcmp(argv[i], "--seed") == 0) { seed = strtoull(argv[++i], NULL, 10); seedGiven = 1; }
+        else if (strcmp(argv[i], "--threads") == 0) numThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--commands") == 0) commands = argv[++i];
+        else if (strcmp(argv[i], "--batch") == 0) batchGames = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--map") == 0) showMap = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--solve") == 0) solve = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--bot") == 0) botDepth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fightcache") == 0) useFightCache = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fight") == 0) fightRoom = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--fork") == 0) numBranches = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--forkat") == 0) forkRoom = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--world") == 0) worldRooms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--population") == 0) populationSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--trials") == 0) trials = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--tune") == 0) tuneTargets = argv[++i];
+        else if (strcmp(argv[i], "--sessions") == 0) numSessions = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--catalog") == 0) catalogSeeds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--find") == 0) findSpec = argv[++i];
+        else if (strcmp(argv[i], "--search") == 0) searchSeeds = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--encounter") == 0) encounterMonsters = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--allies") == 0) numAllies = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--pack") == 0) packSize = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--room") == 0) encounterRoom = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--effects") == 0) useEffects = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--roam") == 0) roamers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--wander") == 0) useWander = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--noise") == 0) useNoise = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--loot") == 0) {
+            if (!loadLoot(argv[++i])) {
+                printf("❌ Buittabel %s kan niet gelezen worden.\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--balance") == 0) {
+            if (!loadBalance(argv[++i], &balance)) {
+                printf("❌ Balans %s kan niet gelezen worden.\n", argv[i]);
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--script") == 0) {
+            script = fopen(argv[++i], "r");
+            if (!script) {
+                printf("❌ Script %s kan niet geopend worden.\n", argv[i]);
+                return 1;
+            }
+        }
+    }
+    if (!lootBuild()) {
+        printf("❌ Elke dieptezone van de buittabel heeft een item met gewicht nodig.\n");
+        return 1;
+    }
+    if (botDepth < 0) botDepth = 0;
+    if (botDepth > BOT_MAX_DEPTH) botDepth = BOT_MAX_DEPTH;
+    if (packSize < 1) packSize = 1;
+    packAllies = numAllies > 0 ? numAllies : 0;
+    if (batchGames > 0) {
+        // Cached fights skip the rounds that effects tick on
+        runBatch(batchGames, seed, numThreads, botDepth, useFightCache && !useEffects);
+        return 0;
+    }
+    if (roamers > 0) {
+        runRoam(roamers, worldRooms, seed, numThreads);
+        return 0;
+    }
+    if (encounterMonsters > 0) {
+        runEncounters(encounterMonsters, numAllies, encounterRoom, seed);
+        return 0;
+    }
+    if (catalogSeeds > 0) {
+        buildCatalog(seedGiven ? seed : 0, catalogSeeds, numThreads);
+        return 0;
+    }
+    if (findSpec) {
+        findSeeds(findSpec, seedGiven ? seed : 0, searchSeeds, numThreads);
+        return 0;
+    }
+    if (numSessions > 0) {
+        runSessions(numSessions, seed);
+        return 0;
+    }
+    if (tuneTargets) {
+        runTune(tuneTargets, seed, numThreads);
+        return 0;
+    }
+    if (populationSize > 0) {
+        runPopulation(populationSize, trials, seed, numThreads);
+        return 0;
+    }
+    if (numBranches > 0) {
+        runForks(worldRooms, numBranches, forkRoom, seed);
+        return 0;
+    }
+    if (fightRoom >= 0) {
+        Room* rooms = generateDungeonSeeded(50, seed, numThreads);
+        showFight(rooms, 50, fightRoom);
+        freeDungeon(rooms, 50);
+        return 0;
+    }
+    if (solve) {
+        Room* rooms = generateDungeonSeeded(50, seed, numThreads);
+        int sneak = solve == 2;
+        long long numStates = 0;
+        clock_t start = clock();
+        double best = solveDungeon(rooms, 50, sneak, numThreads, &numStates);
+        printf("🔹 Seed %llu%s: beste overlevingskans %.4f%% (%lld toestanden, %.2fs CPU)\n",
+               (unsigned long long)seed, sneak ? ", met sluipen" : "", 100.0 * best, numStates,
+               (double)(clock() - start) / CLOCKS_PER_SEC);
+        freeDungeon(rooms, 50);
+        return 0;
+    }
+    InputQueue input;
+    inputInit(&input, script, commands);
+    if (!seedGiven && !useWander) readSaveSeed(&seed);
+    rngSeed(seed);
+
+    int numRooms = 50;
+    Room* dungeon = generateDungeonSeeded(numRooms, seed, numThreads);
+    printf("🔹 Dungeon seed: %llu\n", (unsigned long long)seed);
+    Player player = {100, 10, 10, 10, 1, 0, 100, NULL, NULL};
+    Journal journal = {0};
+    journal.seed = seed;
+    journal.rooms = dungeon;
+    journal.numRooms = numRooms;
+
+    // Where the roaming monsters are is not in the save, so --wander games are not saved
+    int loaded = useWander ? 0 : loadGame(&player, &journal);
+    if (loaded < 0) {
+        char answer = readCommand(&input, "⚠️  Het opgeslagen spel hoort bij een andere dungeon. Overschrijven (J/N)?\nInvoer: ");
+        if (answer != 'j' && answer != 'J') {
+            printf("🔹 Opgeslagen spel blijft bewaard. Start zonder --seed om het te hervatten.\n");
+            freeDungeon(dungeon, numRooms);
+            if (script != stdin) fclose(script);
+            return 0;
+        }
+    }
+    if (useWander) {
+        printf("🔹 Nieuw spel met zwervende monsters, het wordt niet opgeslagen.\n");
+        player.currentRoom = &dungeon[0];
+    } else if (loaded <= 0) {
+        printf(loaded ? "🔹 Nieuw spel wordt gestart.\n" : "🔹 Geen opgeslagen spel gevonden. Nieuw spel wordt gestart.\n");
+        player.currentRoom = &dungeon[0];
+        saveGame(&player, &journal);
+    } else {
+        printf("🔹 Spel geladen. Welkom terug, Speler!\n");
+    }
+    Equipment gear;
+    gearInit(&gear, &player);
+    StatusWheel wheel;
+    if (useEffects) {
+        wheelInit(&wheel);
+        statusWheel = &wheel;
+    }
+    NoiseField noise;
+    if (useNoise) {
+        noiseInit(&noise, dungeon, numRooms);
+        noiseField = &noise;
+    }
+    Wander roaming;
+    if (useWander) {
+        wanderInit(&roaming, dungeon, numRooms, seed);
+        wander = &roaming;
+    }
+    Player logged = player;
+    Minimap map = {0};
+    if (showMap) minimapInit(&map, dungeon, numRooms);
+    RoomText roomText;
+    roomTextInit(&roomText, numRooms);
+    Bot bot;
+    if (botDepth) {
+        botInit(&bot, botDepth);
+        botStartGame(&bot, dungeon, numRooms);
+    }
+
+    char choice;
+    int entered = 1;  // the room is only resolved on entry, not again after I, X or a wrong key
+    while (1) {
+        Room* room = player.currentRoom;
+        minimapDraw(&map, dungeon, room);
+        displayRoom(&roomText, room);
+
+        if (entered) {
+            int hadMonster = room->hasMonster, hadItem = room->hasItem;
+            TurnResult result = botDepth ? resolveRoom(&player, botChooseSneak, &bot) : resolveRoom(&player, askSneak, &input);
+            room->visited = 1;
+            if (result != TURN_CONTINUE) {
+                if (!useWander) deleteSave(&journal);
+                break;
+            }
+            if (hadMonster && !room->hasMonster) journalAppend(&journal, JOURNAL_ROOM_CLEARED, 0, room->id, 0);
+            if (hadItem && !room->hasItem) journalAppend(&journal, JOURNAL_ITEM_TAKEN, 0, room->id, 0);
+            playerStats(&player);
+            journalStats(&journal, &logged, &player);
+            if (journal.numPending > JOURNAL_BATCH - JOURNAL_TURN_RECORDS) journalFlush(&journal);
+            if (journal.sinceSnapshot >= JOURNAL_COMPACT_EVERY) saveGame(&player, &journal);
+            entered = 0;
+        }
+
+        if (botDepth) {
+            Room* next = forwardRoom(room);
+            choice = 'q';
+            for (int d = 0; d < 4; d++) {
+                if (next && room->connections[d] == next) choice = "wdsa"[d];
+            }
+            printf("🤖 Bot kiest %c\n", choice);
+        } else {
+            choice = readCommand(&input, "\n🔹 Wat wil Speler doen?\nBeweeg met W (noord), A (west), S (zuid), D (oost)\nStatus bekijken: I\nOpslaan: X\nStoppen: Q\nInvoer: ");
+        }
+
+        if (choice == 'q' || choice == 'Q') break;
+        if (choice == 'x' || choice == 'X') {
+            if (useWander) {
+                printf("❌ Met zwervende monsters kan het spel niet opgeslagen worden.\n");
+                continue;
+            }
+            saveGame(&player, &journal);
+            printf("💾 Spel opgeslagen.\n");
+            continue;
+        }
+        if (choice == 'i' || choice == 'I') {
+            displayPlayerStats(&player);
+            continue;
+        }
+
+        int dir = -1;
+        if (choice == 'w' || choice == 'W') dir = 0;
+        else if (choice == 'd' || choice == 'D') dir = 1;
+        else if (choice == 's' || choice == 'S') dir = 2;
+        else if (choice == 'a' || choice == 'A') dir = 3;
+
+        if (dir >= 0 && player.currentRoom->connections[dir]) {
+            player.currentRoom = player.currentRoom->connections[dir];
+            entered = 1;
+            journalAppend(&journal, JOURNAL_MOVE, 0, player.currentRoom->id, 0);
+            if (moveTick(&player, player.currentRoom->id) == TURN_DIED) {
+                printf("☠️  Speler bezwijkt onderweg...\n");
+                if (!useWander) deleteSave(&journal);
+                break;
+            }
+            // The monsters moved, so the bot's cached values are stale
+            if (wander && botDepth) botStartGame(&bot, dungeon, numRooms);
+        } else {
+            printf("❌ Geen kamer in die richting.\n");
+        }
+    }
+
+    if (botDepth) botFree(&bot);
+    if (noiseField) {
+        noiseField = NULL;
+        noiseFree(&noise);
+    }
+    if (wander) {
+        wander = NULL;
+        wanderFree(&roaming);
+    }
+    minimapClose(&map);
+    roomTextFree(&roomText);
+    journalClose(&journal);
+    freeDungeon(dungeon, numRooms);
+    if (script != stdin) fclose(script);
+    return 0;
+}
+
+// Every room only reads its own random stream, so chunks can be built in any
+// order on any number of threads and the dungeon stays the same for a seed.
+Room* generateDungeonSeeded(int numRooms, uint64_t seed, int numThreads) {
+    Room* rooms = malloc(sizeof(Room) * numRooms);
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > numRooms) numThreads = numRooms;
+
+    GenChunk* chunks = malloc(sizeof(GenChunk) * numThreads);
+    for (int t = 0; t < numThreads; t++) {
+        chunks[t].rooms = rooms;
+        chunks[t].monsters = NULL;
+        chunks[t].numRooms = numRooms;
+        chunks[t].first = (int)((long long)numRooms * t / numThreads);
+        chunks[t].last = (int)((long long)numRooms * (t + 1) / numThreads);
+        chunks[t].seed = seed;
+        chunks[t].balance = &balance;
+    }
+    runParallel(generateRoomsChunk, chunks, sizeof(GenChunk), numThreads);
+    free(chunks);
+    return rooms;
+}
+
+void poolInit(WorldPool* pool, int capacity) {
+    pool->rooms = malloc(sizeof(Room) * capacity);
+    pool->monsters = malloc(sizeof(Monster) * capacity);
+    pool->capacity = capacity;
+}
+
+// Rebuilds a dungeon in the pool's storage; only allocates when the pool has to grow
+Room* poolGenerateDungeon(WorldPool* pool, int numRooms, uint64_t seed, const Balance* b) {
+    if (numRooms > pool->capacity) {
+        poolFree(pool);
+        poolInit(pool, numRooms);
+    }
+    GenChunk all = {pool->rooms, pool->monsters, numRooms, 0, numRooms, seed, b};
+    generateRoomsChunk(&all);
+    return pool->rooms;
+}
+
+void poolFree(WorldPool* pool) {
+    free(pool->rooms);
+    free(pool->monsters);
+    pool->rooms = NULL;
+    pool->monsters = NULL;
+    pool->capacity = 0;
+}
+
+// Headless games split over threads; game g always uses the same seeds,
+// so results don't depend on the thread count.
+void runBatch(int numGames, uint64_t seed, int numThreads, int botDepth, int useFightCache) {
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > numGames) numThreads = numGames;
+    BatchShard* shards = calloc(numThreads, sizeof(BatchShard));
+    for (int t = 0; t < numThreads; t++) {
+        shards[t].first = (int)((long long)numGames * t / numThreads);
+        shards[t].last = (int)((long long)numGames * (t + 1) / numThreads);
+        shards[t].numRooms = 50;
+        shards[t].seed = seed;
+        shards[t].botDepth = botDepth;
+    }
+
+    FightCache cache;
+    if (useFightCache) {
+        fightCacheInit(&cache);
+        fightCache = &cache;
+    }
+    quietMode = 1;
+    clock_t start = clock();
+    runParallel(batchShardRun, shards, sizeof(BatchShard), numThreads);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    quietMode = 0;
+    fightCache = NULL;
+
+    int wins = 0, deaths = 0;
+    long long deathRoomSum = 0, botDecisions = 0, botLookups = 0, botHits = 0;
+    RunStats* stats = calloc(1, sizeof(RunStats));
+    for (int t = 0; t < numThreads; t++) {
+        statsMerge(stats, &shards[t].stats);
+        wins += shards[t].wins;
+        deaths += shards[t].deaths;
+        deathRoomSum += shards[t].deathRoomSum;
+        botDecisions += shards[t].botDecisions;
+        botLookups += shards[t].botLookups;
+        botHits += shards[t].botHits;
+    }
+    printf("🔹 %d spellen gespeeld (%d threads, %.2fs CPU)\n", numGames, numThreads, seconds);
+    printf("  Gewonnen: %d (%.1f%%)\n", wins, 100.0 * wins / numGames);
+    printf("  Verloren: %d, gemiddeld in kamer %.1f\n", deaths, deaths ? (double)deathRoomSum / deaths : 0.0);
+    statsPrint(stats);
+    free(stats);
+    if (botDepth) {
+        printf("  Bot (%d kamers vooruit): %lld keuzes, cache %.1f%% raak\n", botDepth, botDecisions,
+               botLookups ? 100.0 * botHits / botLookups : 0.0);
+    }
+    if (useFightCache) {
+        long long hits = 0, misses = 0;
+        for (int i = 0; i < FIGHT_CACHE_STRIPES; i++) {
+            hits += cache.hits[i];
+            misses += cache.misses[i];
+        }
+        printf("  Gevechtscache: %lld gevechten, %.1f%% raak\n", hits + misses,
+               hits + misses ? 100.0 * hits / (hits + misses) : 0.0);
+        fightCacheFree(&cache);
+    }
+    free(shards);
+}
+
+void batchShardRun(void* arg) {
+    BatchShard* shard = (BatchShard*)arg;
+    Bot bot;
+    if (shard->botDepth) botInit(&bot, shard->botDepth);
+    poolInit(&shard->pool, shard->numRooms);
+    runStats = &shard->stats;
+    StatusWheel* wheel = useEffects ? malloc(sizeof(StatusWheel)) : NULL;
+    statusWheel = wheel;
+    NoiseField noise;
+    if (useNoise) {
+        noiseInit(&noise, shard->pool.rooms, shard->numRooms);
+        noiseField = &noise;
+    }
+    for (int g = shard->first; g < shard->last; g++) {
+        if (wheel) wheelInit(wheel);
+        if (noiseField) noiseReset(noiseField);
+        uint64_t gameSeed = mix64(shard->seed + (uint64_t)g);
+        Room* rooms = poolGenerateDungeon(&shard->pool, shard->numRooms, gameSeed, &balance);
+        rngSeed(gameSeed);
+        Player player = {100, 10, 10, 10, 1, 0, 100, NULL, NULL};
+        TurnResult result;
+        if (shard->botDepth) {
+            botStartGame(&bot, rooms, shard->numRooms);
+            result = playHeadless(&player, rooms, botChooseSneak, &bot);
+        } else {
+            result = playHeadless(&player, rooms, NULL, NULL);
+        }
+        if (result == TURN_WON) {
+            shard->wins++;
+        } else {
+            shard->deaths++;
+            shard->deathRoomSum += player.currentRoom->id;
+            statsAdd(runStats, HIST_DEATH_ROOM, player.currentRoom->id);
+        }
+        statsAdd(runStats, HIST_LEVEL, player.level);
+    }
+    runStats = NULL;
+    statusWheel = NULL;
+    free(wheel);
+    if (noiseField) {
+        noiseField = NULL;
+        noiseFree(&noise);
+    }
+    poolFree(&shard->pool);
+    if (shard->botDepth) {
+        shard->botDecisions = bot.decisions;
+        shard->botLookups = bot.lookups;
+        shard->botHits = bot.hits;
+        botFree(&bot);
+    }
+}
+
+void generateRoomsChunk(void* arg) {
+    GenChunk* c = (GenChunk*)arg;
+    Room* rooms = c->rooms;
+    for (int i = c->first; i < c->last; i++) {
+        rooms[i].id = i;
+        rooms[i].hasMonster = roomRandom(c->seed, i, STREAM_MONSTER) & 1;
+        rooms[i].hasItem = roomRandom(c->seed, i, STREAM_ITEM) & 1;
+        rooms[i].hasTreasure = i == c->numRooms - 1;
+        rooms[i].visited = 0;
+        int links[4];
+        roomLinks(c->seed, i, c->numRooms, links);
+        for (int j = 0; j < 4; j++) rooms[i].connections[j] = links[j] >= 0 ? &rooms[links[j]] : NULL;
+
+        rooms[i].events = roomEvents(rooms[i].hasMonster);
+        if (rooms[i].hasMonster) {
+            rooms[i].monster = c->monsters ? &c->monsters[i] : malloc(sizeof(Monster));
+            rollMonster(rooms[i].monster, i, c->balance);
+            if (packSize > 1) rooms[i].monster->count = 1 + (int)(roomRandom(c->seed, i, STREAM_PACK) % (uint64_t)packSize);
+        } else {
+            rooms[i].monster = NULL;
+        }
+    }
+}
+
+// Monsters get stronger deeper into the dungeon
+void rollMonster(Monster* m, int room, const Balance* b) {
+    float scale = 1 + b->growth * room;
+    m->hp = b->hp * scale;
+    m->attack = b->attack * scale;
+    m->defense = b->defense * scale;
+    m->speed = b->speed * scale;
+    m->xp = b->xp * scale;
+    m->type = (room % 2 == 0) ? GOBLIN : ORC;
+    m->count = 1;
+}
+
+// Treasure, monster, item: everything that happens on entering a room. Like in V2.6
+// half of the monsters sleep and sneaking past one works half the time; the one
+// guarding the treasure has to be fought. Without a policy every monster is fought.
+// With --noise a sleeping monster wakes up when its room is loud enough.
+// Enter and first-visit events go out before anything happens, the rest with the outcome.
+TurnResult resolveRoom(Player* player, SneakPolicy sneak, void* ctx) {
+    Room* room = player->currentRoom;
+    EventQueue events;
+    events.count = 0;
+    eventPush(&events, EVENT_ENTER, room, player);
+    if (!room->visited) eventPush(&events, EVENT_FIRST_VISIT, room, player);
+    eventDispatch(&events);
+    if (room->hasTreasure && !room->hasMonster) {
+        eventPush(&events, EVENT_TREASURE, room, player);
+        eventDispatch(&events);
+        return TURN_WON;
+    }
+
+    if (room->hasMonster) {
+        int sneaked = 0, asleep = sneak && !room->hasTreasure && (rngNext64() >> 63);
+        if (asleep && noiseField && noiseLevel(noiseField, room->id) >= NOISE_WAKE) {
+            LOG("👂 Het monster is wakker geworden van het lawaai.\n");
+            asleep = 0;
+        }
+        if (asleep) {
+            LOG("💤 Het monster slaapt.\n");
+            if (sneak(player, ctx)) {
+                sneaked = (int)(rngNext64() >> 63);
+                if (sneaked) LOG("💤 Speler sluipt langs het monster.\n");
+                else LOG("⚠️  Speler kan het monster niet ontwijken! Speler moet vechten.\n");
+            }
+        }
+        if (!sneaked) {
+            eventPush(&events, EVENT_COMBAT_START, room, player);
+            eventDispatch(&events);
+            if (packFight(room)) encounterCombat(player);
+            else if (fightCache) cachedCombat(player);
+            else bitwiseCombat(player);
+            if (noiseField) {
+                int heard = noiseEmit(noiseField, room->id, NOISE_FIGHT);
+                LOG("🔊 Het gevecht is te horen in %d kamers.\n", heard - 1);
+            }
+            if (player->hp <= 0) return TURN_DIED;
+            room->hasMonster = 0;
+        }
+    }
+
+    if (room->hasItem) {
+        int item = getItem(player, room->id);
+        room->hasItem = 0;
+        RoomEvent* pickup = eventPush(&events, EVENT_ITEM_PICKUP, room, player);
+        if (pickup) pickup->item = item;
+        // A --loot item can cost HP; the solver and bot count that as a death too
+        if (player->hp <= 0) {
+            eventDispatch(&events);
+            LOG("☠️  Speler is verslagen...\n");
+            return TURN_DIED;
+        }
+    }
+    TurnResult result = room->hasTreasure && !room->hasMonster ? TURN_WON : TURN_CONTINUE;
+    if (result == TURN_WON) eventPush(&events, EVENT_TREASURE, room, player);
+    eventDispatch(&events);
+    return result;
+}
+
+// Only asked once the queued commands are used up: a queued s is a move south, so
+// with moves still waiting the player fights and the moves stay queued
+int askSneak(Player* player, void* input) {
+    (void)player;
+    InputQueue* in = (InputQueue*)input;
+    if (in->pos < in->len) {
+        printf("⚔️  Er staan nog zetten klaar, Speler vecht.\n");
+        return 0;
+    }
+    char choice = readCommand(in, "👹 Vechten (F) of proberen te ontwijken (S)?\nInvoer: ");
+    return choice == 's' || choice == 'S';
+}
+
+// The link to the next room is set last during generation, so it is never overwritten
+Room* forwardRoom(Room* room) {
+    for (int d = 0; d < 4; d++) {
+        Room* next = room->connections[d];
+        if (next && next->id == room->id + 1) return next;
+    }
+    return NULL;
+}
+
+// Plays a whole game without input: always walk on towards the treasure
+TurnResult playHeadless(Player* player, Room* rooms, SneakPolicy sneak, void* ctx) {
+    player->currentRoom = &rooms[0];
+    while (1) {
+        TurnResult result = resolveRoom(player, sneak, ctx);
+        if (result != TURN_CONTINUE) return result;
+        if (player->currentRoom->hasTreasure) continue;
+        Room* next = forwardRoom(player->currentRoom);
+        if (!next) return TURN_DIED;
+        player->currentRoom = next;
+        if (moveTick(player, next->id) == TURN_DIED) return TURN_DIED;
+    }
+}
+
+// What a move costs before the next room is resolved: the steps are heard and
+// status effects run for a round
+TurnResult moveTick(Player* player, int room) {
+    if (wander) wanderTick(wander);
+    if (noiseField) noiseMove(noiseField, room);
+    if (statusWheel) {
+        wheelTick(statusWheel);
+        if (player->hp <= 0) return TURN_DIED;
+    }
+    return TURN_CONTINUE;
+}
+
+// Like the old room action, only monster rooms announce a first visit
+unsigned roomEvents(int hasMonster) {
+    unsigned events = EVENT_BIT(EVENT_ENTER) | EVENT_BIT(EVENT_ITEM_PICKUP) | EVENT_BIT(EVENT_TREASURE);
+    if (hasMonster) events |= EVENT_BIT(EVENT_FIRST_VISIT) | EVENT_BIT(EVENT_COMBAT_START);
+    return events;
+}
+
+// Only rendered again when the room's flags or monster HP changed since last time,
+// so standing in a room (status, save) just copies the same text out again
+void displayRoom(RoomText* cache, Room* room) {
+    if (quietMode) return;
+    int hasMonster = room->hasMonster && room->monster;
+    int key = hasMonster | room->hasItem << 1 | room->hasTreasure << 2;
+    if (hasMonster) key |= room->monster->hp << 3;
+    const Monster* m = hasMonster ? room->monster : NULL;
+    char* text = cache->text + (size_t)room->id * ROOM_TEXT_SIZE;
+    if (cache->key[room->id] != key || cache->monster[room->id] != m) {
+        int n = snprintf(text, ROOM_TEXT_SIZE, "\n🔹 --- Kamer %d ---\n", room->id);
+        if (hasMonster && room->monster->count > 1) {
+            n += snprintf(text + n, ROOM_TEXT_SIZE - n, "👹 %d× %s aanwezig: HP=%d, ATK=%d\n", room->monster->count,
+                          room->monster->type == GOBLIN ? "Goblin" : "Orc",
+                          room->monster->hp, room->monster->attack);
+        } else if (hasMonster) {
+            n += snprintf(text + n, ROOM_TEXT_SIZE - n, "👹 %s aanwezig: HP=%d, ATK=%d\n",
+                          room->monster->type == GOBLIN ? "Goblin" : "Orc",
+                          room->monster->hp, room->monster->attack);
+        }
+        if (room->hasItem) n += snprintf(text + n, ROOM_TEXT_SIZE - n, "✨ Speler vindt een item.\n");
+        if (room->hasTreasure) n += snprintf(text + n, ROOM_TEXT_SIZE - n, "💰 Er ligt een schat!\n");
+        cache->length[room->id] = n;
+        cache->key[room->id] = key;
+        cache->monster[room->id] = m;
+    }
+    fwrite(text, 1, cache->length[room->id], stdout);
+}
+
+void roomTextInit(RoomText* cache, int numRooms) {
+    cache->numRooms = numRooms;
+    cache->text = malloc((size_t)numRooms * ROOM_TEXT_SIZE);
+    cache->length = malloc(sizeof(int) * numRooms);
+    cache->key = malloc(sizeof(int) * numRooms);
+    cache->monster = malloc(sizeof(Monster*) * numRooms);
+    for (int i = 0; i < numRooms; i++) {
+        cache->key[i] = -1;
+        cache->monster[i] = NULL;
+    }
+}
+
+void roomTextFree(RoomText* cache) {
+    free(cache->text);
+    free(cache->length);
+    free(cache->key);
+    free(cache->monster);
+}
+
+void bitwiseCombat(Player* player) {
+    playerStats(player);
+    Monster* m = player->currentRoom->monster;
+    const char* monsterName = m->type == GOBLIN ? "Goblin" : "Orc";
+    int round = 1, startHp = player->hp, monsterStartHp = m->hp;
+    PatternSource patterns = {0, 0};
+
+    int playerDmg = player->damage - m->defense;
+    if (playerDmg < 1) playerDmg = 1;
+    int monsterDmg = m->attack - player->defense;
+    if (monsterDmg < 1) monsterDmg = 1;
+    int monsterCanDodge = player->speed - m->speed > 0;
+    int playerCanDodge = m->speed - player->speed > 0;
+    while (player->hp > 0 && m->hp > 0) {
+        int stunned = 0;
+        if (statusWheel) {
+            wheelTick(statusWheel);
+            if (player->hp <= 0 || m->hp <= 0) break;
+            stunned = statusWheel->playerStunned > 0;
+            if (stunned) LOG("💫 Speler is verdoofd en valt deze beurt niet aan.\n");
+        }
+        int pattern = nextPattern(&patterns);
+        if (!quietMode) {
+            printf("\n🔹 Aanvalsvolgorde (Beurt %02d): Bitpatroon: ", round);
+            for (int i = 3; i >= 0; i--) printf("%d", (pattern >> i) & 1);
+            printf("\n");
+        }
+        round++;
+
+        // Fast path: no dodge possible this round and nobody dies, so order doesn't matter
+        int playerHits = popcount64((uint64_t)pattern);
+        int monsterHits = 4 - playerHits;
+        if (stunned) playerHits = 0;
+        if (!(monsterCanDodge && playerHits) && !(playerCanDodge && monsterHits) &&
+            m->hp > playerHits * playerDmg && player->hp > monsterHits * monsterDmg) {
+            m->hp -= playerHits * playerDmg;
+            player->hp -= monsterHits * monsterDmg;
+            if (statusWheel) statusOnHit(statusWheel, player, m, monsterHits);
+            if (playerHits) LOG("⚔️ Speler doet %dx %d schade aan %s. %s HP: %d\n", playerHits, playerDmg, monsterName, monsterName, m->hp);
+            if (monsterHits) LOG("💥 %s doet %dx %d schade aan Speler. Speler HP: %d\n", monsterName, monsterHits, monsterDmg, player->hp);
+            LOG("-----------------------------\n");
+            continue;
+        }
+
+        for (int i = 3; i >= 0; i--) {
+            if (player->hp <= 0 || m->hp <= 0) break;
+
+            if ((pattern >> i) & 1) {
+                if (stunned) continue;
+                if (dodgeRoll(player->speed - m->speed)) {
+                    LOG("🛡️ %s ontwijkt de aanval van Speler!\n", monsterName);
+                } else {
+                    m->hp -= playerDmg;
+                    LOG("⚔️ Speler doet %d schade aan %s. %s HP: %d\n", playerDmg, monsterName, monsterName, m->hp);
+                }
+            } else {
+                if (dodgeRoll(m->speed - player->speed)) {
+                    LOG("🛡️ Speler ontwijkt de aanval van %s!\n", monsterName);
+                } else {
+                    player->hp -= monsterDmg;
+                    LOG("💥 %s doet %d schade aan Speler. Speler HP: %d\n", monsterName, monsterDmg, player->hp);
+                    if (statusWheel && player->hp > 0) statusOnHit(statusWheel, player, m, 1);
+                }
+            }
+        }
+        LOG("-----------------------------\n");
+    }
+
+    if (statusWheel) effectCancel(statusWheel, &m->hp);
+    if (runStats) {
+        statsAdd(runStats, HIST_ROUNDS, round - 1);
+        if (m->hp <= 0) statsAdd(runStats, HIST_DAMAGE_DEALT, monsterStartHp);
+        statsAdd(runStats, HIST_DAMAGE_TAKEN, startHp - (player->hp > 0 ? player->hp : 0));
+    }
+    if (player->hp > 0) defeatMonster(player, m);
+    else LOG("☠️  Speler is verslagen...\n");
+}
+
+// Same fight as bitwiseCombat, but the number of hits taken is drawn from the
+// shared outcome cache in one step
+void cachedCombat(Player* player) {
+    playerStats(player);
+    Monster* m = player->currentRoom->monster;
+    int monsterDmg = m->attack - player->defense;
+    if (monsterDmg < 1) monsterDmg = 1;
+    double u = (double)(rngNext64() >> 11) / 9007199254740992.0;
+    int startHp = player->hp;
+    player->hp -= fightCacheSample(fightCache, player, m, u) * monsterDmg;
+    // Rounds are not known here
+    if (runStats) {
+        statsAdd(runStats, HIST_DAMAGE_TAKEN, startHp - (player->hp > 0 ? player->hp : 0));
+        if (player->hp > 0) statsAdd(runStats, HIST_DAMAGE_DEALT, m->hp);
+    }
+    if (player->hp > 0) {
+        m->hp = 0;
+        defeatMonster(player, m);
+    } else {
+        LOG("☠️  Speler is verslagen...\n");
+    }
+}
+
+void defeatMonster(Player* player, Monster* m) {
+    LOG("✅ Speler verslaat de %s. +%d XP\n", m->type == GOBLIN ? "Goblin" : "Orc", m->xp);
+    static const ItemDelta killBonus = {1, 1, 1, 1};
+    player->experience += m->xp;
+    playerModify(player, MOD_BASE, &killBonus);
+    LOG("📈 Speler wordt sterker! +1 op alle statistieken:\n");
+    LOG("  +1 HP, +1 Damage, +1 Defense, +1 Speed\n");
+    displayPlayerStats(player);
+    while (player->experience >= player->expToNextLevel) levelUp(player);
+}
+
+// One alias draw: the high 32 bits pick a column, the low 32 bits item or alias
+// Returns the lootItems index; the ITEM_PICKUP handler tells the player
+int getItem(Player* player, int room) {
+    const LootBand* band = &lootBands[lootBand(room)];
+    uint64_t r = rngNext64();
+    int k = (int)(((r >> 32) * (uint64_t)numLootItems) >> 32);
+    if ((uint32_t)r >= band->threshold[k]) k = band->alias[k];
+    itemApply(player, &lootItems[k].delta);
+    return k;
+}
+
+// Equips the item; HP is healed right away, it is not a derived stat
+void itemApply(Player* player, const ItemDelta* delta) {
+    Equipment* gear = player->gear;
+    if (!gear || gear->numItems == GEAR_SLOTS) {
+        playerModify(player, MOD_BASE, delta);
+        return;
+    }
+    player->hp += delta->hp;
+    gear->items[gear->numItems] = *delta;
+    gear->items[gear->numItems++].hp = 0;
+    gear->dirty = 1;
+}
+
+void playerModify(Player* player, ModifierLayer layer, const ItemDelta* delta) {
+    player->hp += delta->hp;
+    Equipment* gear = player->gear;
+    if (!gear) {
+        player->damage += delta->damage;
+        player->defense += delta->defense;
+        player->speed += delta->speed;
+        return;
+    }
+    ItemDelta* m = &gear->layers[layer];
+    m->damage += delta->damage;
+    m->defense += delta->defense;
+    m->speed += delta->speed;
+    gear->dirty = 1;
+}
+
+// Brings the player's damage, defense and speed up to date with the gear
+void playerStats(Player* player) {
+    Equipment* gear = player->gear;
+    if (!gear || !gear->dirty) return;
+    int damage = 0, defense = 0, speed = 0;
+    for (int l = 0; l < NUM_MOD_LAYERS; l++) {
+        damage += gear->layers[l].damage;
+        defense += gear->layers[l].defense;
+        speed += gear->layers[l].speed;
+    }
+    for (int k = 0; k < gear->numItems; k++) {
+        damage += gear->items[k].damage;
+        defense += gear->items[k].defense;
+        speed += gear->items[k].speed;
+    }
+    player->damage = damage;
+    player->defense = defense;
+    player->speed = speed;
+    gear->dirty = 0;
+}
+
+// Saves keep only the totals, so a loaded game starts with everything in the base layer
+void gearInit(Equipment* gear, Player* player) {
+    memset(gear, 0, sizeof(Equipment));
+    gear->layers[MOD_BASE].damage = (int16_t)player->damage;
+    gear->layers[MOD_BASE].defense = (int16_t)player->defense;
+    gear->layers[MOD_BASE].speed = (int16_t)player->speed;
+    player->gear = gear;
+}
+
+int lootBand(int room) {
+    int band = room / LOOT_BAND_ROOMS;
+    return band < LOOT_BANDS ? band : LOOT_BANDS - 1;
+}
+
+// Vose's alias method per band; 0 if a band has no item with weight
+int lootBuild(void) {
+    static double scaled[LOOT_MAX_ITEMS];
+    static int small[LOOT_MAX_ITEMS], large[LOOT_MAX_ITEMS];
+    int n = numLootItems;
+    for (int b = 0; b < LOOT_BANDS; b++) {
+        LootBand* band = &lootBands[b];
+        int first = b * LOOT_BAND_ROOMS;
+        double total = 0.0;
+        for (int k = 0; k < n; k++) {
+            const LootItem* item = &lootItems[k];
+            double w = first >= item->minRoom ? item->weight + item->perRoom * first : 0.0;
+            band->prob[k] = w > 0.0 ? w : 0.0;
+            total += band->prob[k];
+        }
+        if (total <= 0.0) return 0;
+
+        int numSmall = 0, numLarge = 0;
+        band->meanHp = band->meanDamage = band->meanDefense = band->meanSpeed = 0.0;
+        for (int k = 0; k < n; k++) {
+            const ItemDelta* d = &lootItems[k].delta;
+            band->prob[k] /= total;
+            band->meanHp += band->prob[k] * d->hp;
+            band->meanDamage += band->prob[k] * d->damage;
+            band->meanDefense += band->prob[k] * d->defense;
+            band->meanSpeed += band->prob[k] * d->speed;
+            scaled[k] = band->prob[k] * n;
+            if (scaled[k] < 1.0) small[numSmall++] = k;
+            else large[numLarge++] = k;
+        }
+        while (numSmall && numLarge) {
+            int s = small[--numSmall], l = large[--numLarge];
+            band->threshold[s] = (uint32_t)(scaled[s] * 4294967296.0);
+            band->alias[s] = (uint16_t)l;
+            scaled[l] -= 1.0 - scaled[s];
+            if (scaled[l] < 1.0) small[numSmall++] = l;
+            else large[numLarge++] = l;
+        }
+        // Full columns (and rounding leftovers) always give their own item
+        while (numLarge) {
+            int k = large[--numLarge];
+            band->threshold[k] = UINT32_MAX;
+            band->alias[k] = (uint16_t)k;
+        }
+        while (numSmall) {
+            int k = small[--numSmall];
+            band->threshold[k] = UINT32_MAX;
+            band->alias[k] = (uint16_t)k;
+        }
+    }
+    return 1;
+}
+
+// Lines of "icon hp damage defense speed weight perRoom minRoom name", # starts a comment
+int loadLoot(const char* file) {
+    FILE* f = fopen(file, "r");
+    if (!f) return 0;
+    LootItem* items = calloc(LOOT_MAX_ITEMS, sizeof(LootItem));
+    char line[256];
+    int n = 0;
+    while (n < LOOT_MAX_ITEMS && fgets(line, sizeof(line), f)) {
+        LootItem* item = &items[n];
+        int hp, damage, defense, speed;
+        line[strcspn(line, "\r\n")] = 0;
+        if (line[0] == '#' || sscanf(line, "%15s %d %d %d %d %f %f %d %39[^\n]", item->icon, &hp, &damage, &defense,
+                                     &speed, &item->weight, &item->perRoom, &item->minRoom, item->name) != 9) {
+            continue;
+        }
+        item->delta.hp = (int16_t)hp;
+        item->delta.damage = (int16_t)damage;
+        item->delta.defense = (int16_t)defense;
+        item->delta.speed = (int16_t)speed;
+        n++;
+    }
+    fclose(f);
+    if (!n) {
+        free(items);
+        return 0;
+    }
+    lootItems = items;
+    numLootItems = n;
+    return 1;
+}
+
+void levelUp(Player* player) {
+    static const ItemDelta levelBonus = {10, 5, 5, 5};
+    player->level++;
+    playerModify(player, MOD_LEVEL, &levelBonus);
+    player->experience -= player->expToNextLevel;
+    player->expToNextLevel += 10;
+    LOG("🌟 Speler bereikt level %d! Statistieken verhoogd:\n", player->level);
+    LOG("  +10 HP, +5 Damage, +5 Defense, +5 Speed\n");
+    displayPlayerStats(player);
+}
+
+void displayPlayerStats(Player* p) {
+    playerStats(p);
+    LOG("📊 Speler Stats:\n");
+    LOG("  HP: %d\n", p->hp);
+    LOG("  Damage: %d\n", p->damage);
+    LOG("  Defense: %d\n", p->defense);
+    LOG("  Speed: %d\n", p->speed);
+    LOG("  Level: %d\n", p->level);
+    LOG("  XP: %d/%d\n", p->experience, p->expToNextLevel);
+}
+
+// Writes a full snapshot (player + every room) and starts a new, empty journal.
+// The snapshot is written to a temp file and renamed, so a crash keeps the old one;
+// a journal from an older generation is ignored when loading.
+void saveGame(Player* p, Journal* j) {
+    playerStats(p);
+    FILE* f = fopen(SAVE_TMP_FILE, "wb");
+    if (!f) return;
+    uint32_t header[2] = {SAVE_MAGIC, j->generation + 1};
+    fwrite(header, sizeof(header), 1, f);
+    fwrite(&j->seed, sizeof(uint64_t), 1, f);
+    fwrite(&j->numRooms, sizeof(int), 1, f);
+    for (int s = 0; s < NUM_STATS; s++) fwrite((char*)p + statOffset[s], sizeof(int), 1, f);
+    int id = p->currentRoom->id;
+    fwrite(&id, sizeof(int), 1, f);
+    for (int i = 0; i < j->numRooms; i++) {
+        Room* r = &j->rooms[i];
+        unsigned char flags = (unsigned char)(r->hasMonster | r->hasItem << 1 | r->visited << 2);
+        int monsterHp = r->monster ? r->monster->hp : 0;
+        fwrite(&flags, 1, 1, f);
+        fwrite(&monsterHp, sizeof(int), 1, f);
+    }
+    syncFile(f);
+    fclose(f);
+#ifdef _WIN32
+    if (!MoveFileExA(SAVE_TMP_FILE, SAVE_FILE, MOVEFILE_REPLACE_EXISTING)) return;
+#else
+    if (rename(SAVE_TMP_FILE, SAVE_FILE) != 0) return;
+#endif
+
+    if (j->file) fclose(j->file);
+    j->generation++;
+    j->numPending = 0;
+    j->sinceSnapshot = 0;
+    j->file = fopen(JOURNAL_FILE, "wb");
+    if (!j->file) return;
+    uint32_t jheader[2] = {JOURNAL_MAGIC, j->generation};
+    fwrite(jheader, sizeof(jheader), 1, j->file);
+    syncFile(j->file);
+}
+
+// Loads the snapshot and replays the journal on top of it. Returns 0 without a save,
+// -1 when the save belongs to another dungeon (seed or size) and is left alone.
+int loadGame(Player* p, Journal* j) {
+    FILE* f = fopen(SAVE_FILE, "rb");
+    if (!f) return 0;
+    uint32_t header[2];
+    uint64_t seed;
+    int numRooms, id;
+    if (fread(header, sizeof(header), 1, f) != 1 || header[0] != SAVE_MAGIC ||
+        fread(&seed, sizeof(uint64_t), 1, f) != 1 || seed != j->seed ||
+        fread(&numRooms, sizeof(int), 1, f) != 1 || numRooms != j->numRooms) {
+        fclose(f);
+        return -1;
+    }
+    for (int s = 0; s < NUM_STATS; s++) fread((char*)p + statOffset[s], sizeof(int), 1, f);
+    fread(&id, sizeof(int), 1, f);
+    if (id < 0 || id >= numRooms) id = 0;
+    p->currentRoom = &j->rooms[id];
+    for (int i = 0; i < numRooms; i++) {
+        Room* r = &j->rooms[i];
+        unsigned char flags = 0;
+        int monsterHp = 0;
+        fread(&flags, 1, 1, f);
+        fread(&monsterHp, sizeof(int), 1, f);
+        r->hasMonster = r->monster && (flags & 1);
+        r->hasItem = (flags >> 1) & 1;
+        r->visited = (flags >> 2) & 1;
+        if (r->monster) r->monster->hp = monsterHp;
+    }
+    fclose(f);
+    j->generation = header[1];
+
+    // Replay complete records. A torn record at the end would misalign everything
+    // appended after it, so then the state is compacted into a new snapshot instead.
+    FILE* jf = fopen(JOURNAL_FILE, "rb");
+    uint32_t jheader[2];
+    int replayable = jf && fread(jheader, sizeof(jheader), 1, jf) == 1 &&
+                     jheader[0] == JOURNAL_MAGIC && jheader[1] == j->generation;
+    JournalRecord rec;
+    long numRecords = 0;
+    while (replayable && fread(&rec, sizeof(rec), 1, jf) == 1) {
+        numRecords++;
+        if (rec.room >= numRooms) continue;
+        Room* r = &j->rooms[rec.room];
+        if (rec.type == JOURNAL_MOVE) { p->currentRoom = r; r->visited = 1; }
+        else if (rec.type == JOURNAL_ROOM_CLEARED) { r->hasMonster = 0; r->visited = 1; }
+        else if (rec.type == JOURNAL_ITEM_TAKEN) r->hasItem = 0;
+        else if (rec.type == JOURNAL_STAT && rec.stat < NUM_STATS) *(int*)((char*)p + statOffset[rec.stat]) += rec.value;
+        j->sinceSnapshot++;
+    }
+    int torn = replayable && (fseek(jf, 0, SEEK_END) != 0 ||
+                              ftell(jf) != (long)(sizeof(jheader) + numRecords * sizeof(JournalRecord)));
+    if (jf) fclose(jf);
+
+    if (torn) {
+        saveGame(p, j);
+    } else if (replayable) {
+        j->file = fopen(JOURNAL_FILE, "ab");
+    } else {
+        j->file = fopen(JOURNAL_FILE, "wb");
+        if (j->file) {
+            uint32_t fresh[2] = {JOURNAL_MAGIC, j->generation};
+            fwrite(fresh, sizeof(fresh), 1, j->file);
+            syncFile(j->file);
+        }
+    }
+    return 1;
+}
+
+int readSaveSeed(uint64_t* seed) {
+    FILE* f = fopen(SAVE_FILE, "rb");
+    if (!f) return 0;
+    uint32_t header[2];
+    int ok = fread(header, sizeof(header), 1, f) == 1 && header[0] == SAVE_MAGIC &&
+             fread(seed, sizeof(uint64_t), 1, f) == 1;
+    fclose(f);
+    return ok;
+}
+
+// The run is over: a finished or lost game shouldn't be resumed
+void deleteSave(Journal* j) {
+    if (j->file) fclose(j->file);
+    j->file = NULL;
+    j->numPending = 0;
+    remove(JOURNAL_FILE);
+    remove(SAVE_FILE);
+}
+
+void journalAppend(Journal* j, int type, int stat, int room, int value) {
+    if (!j->file) return;
+    JournalRecord* rec = &j->pending[j->numPending++];
+    rec->type = (uint8_t)type;
+    rec->stat = (uint8_t)stat;
+    rec->room = (uint16_t)room;
+    rec->value = value;
+    if (j->numPending == JOURNAL_BATCH) journalFlush(j);  // not reached: main flushes before a turn could overflow
+}
+
+// Appends one delta record per stat that changed since the last call
+void journalStats(Journal* j, Player* logged, Player* p) {
+    for (int s = 0; s < NUM_STATS; s++) {
+        int before = *(int*)((char*)logged + statOffset[s]);
+        int now = *(int*)((char*)p + statOffset[s]);
+        if (now != before) journalAppend(j, JOURNAL_STAT, s, p->currentRoom->id, now - before);
+    }
+    *logged = *p;
+}
+
+void journalFlush(Journal* j) {
+    if (!j->file || j->numPending == 0) return;
+    fwrite(j->pending, sizeof(JournalRecord), j->numPending, j->file);
+    syncFile(j->file);
+    j->sinceSnapshot += j->numPending;
+    j->numPending = 0;
+}
+
+void journalClose(Journal* j) {
+    journalFlush(j);
+    if (j->file) fclose(j->file);
+    j->file = NULL;
+}
+
+void syncFile(FILE* f) {
+    fflush(f);
+#ifdef _WIN32
+    _commit(_fileno(f));
+#else
+    fsync(fileno(f));
+#endif
+}
+
+void freeDungeon(Room* rooms, int numRooms) {
+    for (int i = 0; i < numRooms; i++) {
+        if (rooms[i].monster) free(rooms[i].monster);
+    }
+    free(rooms);
+}
+
+int registerEventHandler(EventType type, EventHandler handler) {
+    if (numEventHandlers[type] == MAX_EVENT_HANDLERS) return 0;
+    eventHandlers[type][numEventHandlers[type]++] = handler;
+    return 1;
+}
+
+void registerDefaultHandlers(void) {
+    registerEventHandler(EVENT_FIRST_VISIT, onFirstVisit);
+    registerEventHandler(EVENT_COMBAT_START, onCombatStart);
+    registerEventHandler(EVENT_ITEM_PICKUP, onItemPickup);
+    registerEventHandler(EVENT_TREASURE, onTreasure);
+}
+
+// Only events the room dispatches and someone handles are queued
+RoomEvent* eventPush(EventQueue* queue, EventType type, Room* room, Player* player) {
+    if (!(room->events & EVENT_BIT(type)) || !numEventHandlers[type] || queue->count == EVENT_QUEUE_SIZE) return NULL;
+    RoomEvent* e = &queue->events[queue->count++];
+    e->type = type;
+    e->room = room;
+    e->player = player;
+    e->item = -1;
+    return e;
+}
+
+// Each handler gets every queued event of its type in one go
+void eventDispatch(EventQueue* queue) {
+    if (!queue->count) return;
+    for (int type = 0; type < NUM_EVENTS; type++) {
+        for (int h = 0; h < numEventHandlers[type]; h++) {
+            for (int k = 0; k < queue->count; k++) {
+                if (queue->events[k].type == (EventType)type) eventHandlers[type][h](&queue->events[k]);
+            }
+        }
+    }
+    queue->count = 0;
+}
+
+void onFirstVisit(const RoomEvent* event) {
+    event->room->visited = 1;
+    LOG("🔹 Speler betreedt deze kamer voor het eerst.\n");
+}
+
+// Deep monsters heal while they fight; the cached and the pack fight have no wheel ticks
+void onCombatStart(const RoomEvent* event) {
+    Monster* m = event->room->monster;
+    if (statusWheel && !fightCache && !packFight(event->room) && event->room->id >= 25) {
+        effectAdd(statusWheel, EFFECT_REGEN, m->type == GOBLIN ? "Goblin" : "Orc", &m->hp, NULL, 1, 1, WHEEL_MAX_DELAY);
+    }
+}
+
+void onItemPickup(const RoomEvent* event) {
+    if (event->item >= 0) LOG("%s Speler krijgt %s.\n", lootItems[event->item].icon, lootItems[event->item].name);
+}
+
+void onTreasure(const RoomEvent* event) {
+    (void)event;
+    LOG("💰 Speler heeft de schat gevonden! Gefeliciteerd!\n");
+}
+
+void rngSeed(uint64_t seed) {
+    rngState = seed;
+}
+
+uint64_t rngNext64(void) {
+    return mix64(rngState += 0x9E3779B97F4A7C15ULL);
+}
+
+uint64_t mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+int dodgeRoll(int speedDiff) {
+    if (speedDiff <= 0) return 0;
+    if (speedDiff > MAX_DODGE_DIFF) speedDiff = MAX_DODGE_DIFF;
+    return (uint32_t)(rngNext64() >> 32) < dodgeThreshold[speedDiff];
+}
+
+int nextPattern(PatternSource* src) {
+    if (src->left == 0) {
+        src->bits = rngNext64();
+        src->left = 16;
+    }
+    int pattern = (int)(src->bits & 0xF);
+    src->bits >>= 4;
+    src->left--;
+    return pattern;
+}
+
+int popcount64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Index of the lowest set bit; x must not be 0
+int ctz64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(x);
+#else
+    return popcount64((x & (0 - x)) - 1);
+#endif
+}
+
+// Counter-based: the value only depends on (seed, room, stream)
+uint64_t roomRandom(uint64_t seed, int room, int stream) {
+    uint64_t counter = ((uint64_t)(uint32_t)room << 8) | (uint64_t)(stream & 0xFF);
+    return mix64(mix64(seed) + (counter + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+// Neighbours of room per direction (-1 for none). The link to room + 1 goes in a
+// random direction and is set last, like linking room i-1 to i and then i to i+1,
+// so it wins when both links draw the same direction.
+void roomLinks(uint64_t seed, int room, int numRooms, int links[4]) {
+    for (int d = 0; d < 4; d++) links[d] = -1;
+    if (room > 0) links[(roomRandom(seed, room - 1, STREAM_LINK) % 4 + 2) % 4] = room - 1;
+    if (room < numRooms - 1) links[roomRandom(seed, room, STREAM_LINK) % 4] = room + 1;
+}
+
+typedef struct ParallelJob {
+    ParallelTask task;
+    void* arg;
+} ParallelJob;
+
+#ifdef _WIN32
+static DWORD WINAPI parallelEntry(LPVOID p) {
+    ParallelJob* job = (ParallelJob*)p;
+    job->task(job->arg);
+    return 0;
+}
+#else
+static void* parallelEntry(void* p) {
+    ParallelJob* job = (ParallelJob*)p;
+    job->task(job->arg);
+    return NULL;
+}
+#endif
+
+// Runs task(args[k]) for k = 0..count-1, one thread each, and waits for all of them.
+// Task 0 runs on the calling thread; if a thread can't be started its task runs inline.
+void runParallel(ParallelTask task, void* args, size_t argSize, int count) {
+    if (count <= 0) return;
+    ParallelJob* jobs = malloc(sizeof(ParallelJob) * count);
+#ifdef _WIN32
+    HANDLE* threads = malloc(sizeof(HANDLE) * count);
+#else
+    pthread_t* threads = malloc(sizeof(pthread_t) * count);
+#endif
+    int* started = calloc(count, sizeof(int));
+
+    for (int k = 1; k < count; k++) {
+        jobs[k].task = task;
+        jobs[k].arg = (char*)args + k * argSize;
+#ifdef _WIN32
+        threads[k] = CreateThread(NULL, 0, parallelEntry, &jobs[k], 0, NULL);
+        started[k] = threads[k] != NULL;
+#else
+        started[k] = pthread_create(&threads[k], NULL, parallelEntry, &jobs[k]) == 0;
+#endif
+        if (!started[k]) task(jobs[k].arg);
+    }
+    task(args);
+    for (int k = 1; k < count; k++) {
+        if (!started[k]) continue;
+#ifdef _WIN32
+        WaitForSingleObject(threads[k], INFINITE);
+        CloseHandle(threads[k]);
+#else
+        pthread_join(threads[k], NULL);
+#endif
+    }
+    free(started);
+    free(threads);
+    free(jobs);
+}
+
+void statsAdd(RunStats* stats, int hist, int value) {
+    if (value < 0) value = 0;
+    stats->counts[hist][value < STAT_BINS ? value : STAT_BINS - 1]++;
+    stats->total[hist]++;
+    stats->sum[hist] += value;
+}
+
+void statsMerge(RunStats* into, const RunStats* from) {
+    for (int h = 0; h < NUM_HISTS; h++) {
+        for (int v = 0; v < STAT_BINS; v++) into->counts[h][v] += from->counts[h][v];
+        into->total[h] += from->total[h];
+        into->sum[h] += from->sum[h];
+    }
+}
+
+// Smallest value with at least a fraction q of the samples at or below it
+int statsQuantile(const RunStats* stats, int hist, double q) {
+    long long need = (long long)(q * stats->total[hist] + 0.5), seen = 0;
+    if (need < 1) need = 1;
+    for (int v = 0; v < STAT_BINS; v++) {
+        seen += stats->counts[hist][v];
+        if (seen >= need) return v;
+    }
+    return STAT_BINS - 1;
+}
+
+void statsPrint(const RunStats* stats) {
+    static const char* names[NUM_HISTS] = {"Rondes per gevecht", "Schade gedaan per gewonnen gevecht",
+                                           "Schade gekregen per gevecht", "Kamer van overlijden", "Level bereikt"};
+    for (int h = 0; h < NUM_HISTS; h++) {
+        if (!stats->total[h]) continue;
+        int top = STAT_BINS - 1;
+        while (top > 0 && !stats->counts[h][top]) top--;
+        printf("  %s: gem %.1f, p50 %d, p90 %d, p99 %d, max %d%s\n", names[h],
+               (double)stats->sum[h] / stats->total[h], statsQuantile(stats, h, 0.5), statsQuantile(stats, h, 0.9),
+               statsQuantile(stats, h, 0.99), top, top == STAT_BINS - 1 ? "+" : "");
+    }
+}
+
+void mutexInit(Mutex* mutex) {
+#ifdef _WIN32
+    InitializeCriticalSection(mutex);
+#else
+    pthread_mutex_init(mutex, NULL);
+#endif
+}
+
+void mutexLock(Mutex* mutex) {
+#ifdef _WIN32
+    EnterCriticalSection(mutex);
+#else
+    pthread_mutex_lock(mutex);
+#endif
+}
+
+void mutexUnlock(Mutex* mutex) {
+#ifdef _WIN32
+    LeaveCriticalSection(mutex);
+#else
+    pthread_mutex_unlock(mutex);
+#endif
+}
+
+void mutexFree(Mutex* mutex) {
+#ifdef _WIN32
+    DeleteCriticalSection(mutex);
+#else
+    pthread_mutex_destroy(mutex);
+#endif
+}
+
+// Prompts are only shown for a terminal; scripts and pipes run silently
+void inputInit(InputQueue* in, FILE* source, const char* commands) {
+    in->pos = in->len = 0;
+    in->source = source;
+#ifdef _WIN32
+    in->showPrompts = source == stdin && _isatty(_fileno(stdin));
+#else
+    in->showPrompts = source == stdin && isatty(fileno(stdin));
+#endif
+    if (commands) inputQueue(in, commands);
+}
+
+void inputQueue(InputQueue* in, const char* commands) {
+    in->pos = in->len = 0;
+    for (const char* c = commands; *c && in->len < INPUT_LINE_SIZE; c++) {
+        if (*c != ' ' && *c != '\t' && *c != '\r' && *c != '\n') in->line[in->len++] = *c;
+    }
+}
+
+// Next queued command; the prompt is only printed once the queue has drained.
+// End of input quits the game.
+char readCommand(InputQueue* in, const char* prompt) {
+    while (in->pos >= in->len) {
+        if (in->showPrompts) printf("%s", prompt);
+        char buffer[INPUT_LINE_SIZE];
+        if (!fgets(buffer, sizeof(buffer), in->source)) return 'q';
+        inputQueue(in, buffer);
+    }
+    return in->line[in->pos++];
+}
+
+// Lays the rooms out on a grid by following each room's link to the next one,
+// reserves the top of the terminal for the map and scrolls the game text below it.
+// Needs an ANSI terminal; returns 0 (map off) otherwise.
+int minimapInit(Minimap* map, Room* rooms, int numRooms) {
+    map->enabled = 0;
+#ifdef _WIN32
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+    HANDLE console = GetStdHandle(STD_OUTPUT_HANDLE);
+    DWORD mode;
+    if (!_isatty(_fileno(stdout)) || !GetConsoleMode(console, &mode) ||
+        !SetConsoleMode(console, mode | ENABLE_VIRTUAL_TERMINAL_PROCESSING)) return 0;
+#else
+    if (!isatty(fileno(stdout))) return 0;
+#endif
+    map->numRooms = numRooms;
+    map->roomX = malloc(sizeof(int) * numRooms);
+    map->roomY = malloc(sizeof(int) * numRooms);
+    static const int dx[4] = {0, 1, 0, -1}, dy[4] = {-1, 0, 1, 0};
+    map->roomX[0] = map->roomY[0] = 0;
+    for (int i = 0; i + 1 < numRooms; i++) {
+        int dir = 0;
+        while (dir < 3 && rooms[i].connections[dir] != &rooms[i + 1]) dir++;
+        map->roomX[i + 1] = map->roomX[i] + dx[dir];
+        map->roomY[i + 1] = map->roomY[i] + dy[dir];
+    }
+    memset(map->front, ' ', sizeof(map->front));
+    map->originX = -MAP_WIDTH / 2;
+    map->originY = -MAP_HEIGHT / 2;
+
+    // Frame, then the scroll region starts under it
+    printf("\x1b[2J\x1b[1;1H+");
+    for (int x = 0; x < MAP_WIDTH; x++) printf("-");
+    printf("+\n");
+    for (int y = 0; y < MAP_HEIGHT; y++) printf("|\x1b[%dG|\n", MAP_WIDTH + 2);
+    printf("+");
+    for (int x = 0; x < MAP_WIDTH; x++) printf("-");
+    printf("+ @ Speler  # bezocht\n");
+    printf("\x1b[%d;r\x1b[%d;1H", MAP_HEIGHT + 3, MAP_HEIGHT + 3);
+    map->enabled = 1;
+    return 1;
+}
+
+// Renders the next frame into back and sends only the changed cells
+void minimapDraw(Minimap* map, Room* rooms, Room* current) {
+    if (!map->enabled) return;
+    // Only scroll when the player gets close to the edge, so most moves change two cells
+    int px = map->roomX[current->id] - map->originX, py = map->roomY[current->id] - map->originY;
+    if (px < 2 || px >= MAP_WIDTH - 2 || py < 1 || py >= MAP_HEIGHT - 1) {
+        map->originX = map->roomX[current->id] - MAP_WIDTH / 2;
+        map->originY = map->roomY[current->id] - MAP_HEIGHT / 2;
+    }
+
+    memset(map->back, ' ', sizeof(map->back));
+    for (int i = 0; i < map->numRooms; i++) {
+        if (!rooms[i].visited) continue;
+        int x = map->roomX[i] - map->originX, y = map->roomY[i] - map->originY;
+        if (x >= 0 && x < MAP_WIDTH && y >= 0 && y < MAP_HEIGHT) map->back[y][x] = '#';
+    }
+    map->back[map->roomY[current->id] - map->originY][map->roomX[current->id] - map->originX] = '@';
+
+    char out[MAP_HEIGHT * MAP_WIDTH * 12 + 16];
+    int len = 0, lastX = -2, lastY = -2;
+    len += sprintf(out + len, "\x1b" "7");
+    for (int y = 0; y < MAP_HEIGHT; y++) {
+        for (int x = 0; x < MAP_WIDTH; x++) {
+            if (map->back[y][x] == map->front[y][x]) continue;
+            // The cursor is already there after writing the cell to the left
+            if (y != lastY || x != lastX + 1) len += sprintf(out + len, "\x1b[%d;%dH", y + 2, x + 2);
+            out[len++] = map->back[y][x];
+            map->front[y][x] = map->back[y][x];
+            lastX = x;
+            lastY = y;
+        }
+    }
+    len += sprintf(out + len, "\x1b" "8");
+    if (lastY >= 0) {
+        fwrite(out, 1, len, stdout);
+        fflush(stdout);
+    }
+}
+
+void minimapClose(Minimap* map) {
+    if (!map->enabled) return;
+    printf("\x1b[r\n");
+    free(map->roomX);
+    free(map->roomY);
+    map->enabled = 0;
+}
+
+// The fight played attack by attack over a grid of (hits taken, hits dealt): every
+// pattern bit is a fair coin, so each attack moves probability one cell right (player
+// lands a hit), one cell down (monster lands one) or leaves it. Leaving the grid
+// ends the fight. Rows are contiguous so the update loops vectorize. Stops once less
+// than epsilon is still fighting; fills out like combatOutcome.
+void combatMarkov(const Player* player, const Monster* m, double epsilon, CombatOutcome* out) {
+    int playerDmg, monsterDmg;
+    double playerHit, monsterHit;
+    fightRates(player, m, &playerDmg, &monsterDmg, &playerHit, &monsterHit);
+    int k = (m->hp + playerDmg - 1) / playerDmg;
+    int j = (player->hp + monsterDmg - 1) / monsterDmg;
+    if (j > out->capacity) {
+        out->capacity = j;
+        out->prob = realloc(out->prob, sizeof(double) * j);
+    }
+    out->q = playerHit / (playerHit + monsterHit);
+    out->hitsToKill = k;
+    out->hpLoss = monsterDmg;
+    out->count = j;
+    for (int i = 0; i < j; i++) out->prob[i] = 0.0;
+
+    double* cur = calloc((size_t)j * k, sizeof(double));
+    double* next = malloc(sizeof(double) * j * k);
+    double right = 0.5 * playerHit, down = 0.5 * monsterHit, stay = 1.0 - right - down;
+    double alive = 1.0;
+    cur[0] = 1.0;
+    out->attacks = 0;
+    while (alive >= epsilon) {
+        for (int a = 0; a < j; a++) {
+            const double* row = cur + (size_t)a * k;
+            double* nrow = next + (size_t)a * k;
+            nrow[0] = row[0] * stay;
+            for (int b = 1; b < k; b++) nrow[b] = row[b] * stay + row[b - 1] * right;
+            if (a > 0) {
+                const double* up = row - k;
+                for (int b = 0; b < k; b++) nrow[b] += up[b] * down;
+            }
+            out->prob[a] += row[k - 1] * right;
+        }
+
+        double* swap = cur;
+        cur = next;
+        next = swap;
+        alive = 0.0;
+        for (size_t c = 0; c < (size_t)j * k; c++) alive += cur[c];
+        out->attacks++;
+    }
+    out->win = 0.0;
+    for (int i = 0; i < j; i++) out->win += out->prob[i];
+    out->unresolved = alive;
+    free(cur);
+    free(next);
+}
+
+// Damage per hit and the chance a hit lands, as in bitwiseCombat
+void fightRates(const Player* player, const Monster* m, int* playerDmg, int* monsterDmg, double* playerHit, double* monsterHit) {
+    *playerDmg = player->damage - m->defense;
+    if (*playerDmg < 1) *playerDmg = 1;
+    *monsterDmg = m->attack - player->defense;
+    if (*monsterDmg < 1) *monsterDmg = 1;
+    int monsterDodge = player->speed - m->speed, playerDodge = m->speed - player->speed;
+    if (monsterDodge > MAX_DODGE_DIFF) monsterDodge = MAX_DODGE_DIFF;
+    if (playerDodge > MAX_DODGE_DIFF) playerDodge = MAX_DODGE_DIFF;
+    *playerHit = 1.0 - (monsterDodge > 0 ? dodgeThreshold[monsterDodge] / 4294967296.0 : 0.0);
+    *monsterHit = 1.0 - (playerDodge > 0 ? dodgeThreshold[playerDodge] / 4294967296.0 : 0.0);
+}
+
+// Every attack is the player's with chance 1/2 (one bit of the pattern) and then lands
+// unless dodged, so the fight is a race between the player's and the monster's hits.
+// Ignoring misses, the player's hit comes first with chance q; winning after taking
+// i hits means k hits in k + i tries with the player's hit last: C(k-1+i, i) q^k (1-q)^i.
+void combatOutcome(const Player* player, const Monster* m, CombatOutcome* out) {
+    int playerDmg, monsterDmg;
+    double playerHit, monsterHit;
+    fightRates(player, m, &playerDmg, &monsterDmg, &playerHit, &monsterHit);
+    double q = playerHit / (playerHit + monsterHit);
+
+    int k = (m->hp + playerDmg - 1) / playerDmg;              // hits to kill the monster
+    int j = (player->hp + monsterDmg - 1) / monsterDmg;       // hits that kill the player
+    if (j > out->capacity) {
+        out->capacity = j;
+        out->prob = realloc(out->prob, sizeof(double) * j);
+    }
+    out->q = q;
+    out->hitsToKill = k;
+    out->hpLoss = monsterDmg;
+    out->count = j;
+    out->win = 0.0;
+    out->unresolved = 0.0;
+    out->attacks = 0;
+    double term = 1.0;
+    for (int h = 0; h < k; h++) term *= q;
+    for (int i = 0; i < j; i++) {
+        if (i > 0) term *= (1.0 - q) * (k - 1 + i) / i;
+        out->prob[i] = term;
+        out->win += term;
+    }
+}
+
+// Best chance to reach the treasure from the start of the dungeon. Forward pass:
+// collect the classes that can enter each room, dropping ones with reach below
+// SOLVER_EPSILON or past the SOLVER_MAX_CLASSES most likely. Backward pass: fill
+// each class's HP row from the next room's rows, split over threads. Dropped classes
+// count as lost, so the result is a lower bound that the solver's own choices achieve.
+double solveDungeon(Room* rooms, int numRooms, int allowSneak, int numThreads, long long* numStates) {
+    Solver solver = {rooms, numRooms, allowSneak, calloc(numRooms, sizeof(SolverLayer))};
+    if (numThreads < 1) numThreads = 1;
+
+    SolverClass start = {10, 10, 10, 1, 0};
+    solverLayerFind(&solver.layers[0], &start, 1.0, 100, 1);
+    solverLayerPrune(&solver.layers[0]);
+    for (int room = 0; room + 1 < numRooms; room++) solverExpand(&solver, room);
+
+    SolverTask* tasks = calloc(numThreads, sizeof(SolverTask));
+    *numStates = 0;
+    for (int room = numRooms - 1; room >= 0; room--) {
+        SolverLayer* layer = &solver.layers[room];
+        size_t cells = 0;
+        layer->offset = malloc(sizeof(size_t) * (layer->count ? layer->count : 1));
+        for (int k = 0; k < layer->count; k++) {
+            layer->offset[k] = cells;
+            cells += layer->hpMax[k] + 1;
+        }
+        layer->value = malloc(sizeof(double) * (cells ? cells : 1));
+        for (int t = 0; t < numThreads; t++) {
+            tasks[t].solver = &solver;
+            tasks[t].room = room;
+            tasks[t].first = (int)((long long)layer->count * t / numThreads);
+            tasks[t].last = (int)((long long)layer->count * (t + 1) / numThreads);
+        }
+        runParallel(solverBackwardTask, tasks, sizeof(SolverTask), numThreads);
+        *numStates += (long long)cells;
+        if (room + 1 < numRooms) solverLayerFree(&solver.layers[room + 1]);
+    }
+    double best = solver.layers[0].value[100];
+
+    solverLayerFree(&solver.layers[0]);
+    for (int t = 0; t < numThreads; t++) {
+        free(tasks[t].outcome.prob);
+        free(tasks[t].after);
+        free(tasks[t].fight);
+    }
+    free(tasks);
+    free(solver.layers);
+    return best;
+}
+
+// Adds every class that can leave room to the next layer
+void solverExpand(Solver* solver, int room) {
+    SolverLayer* layer = &solver->layers[room];
+    Room* r = &solver->rooms[room];
+    for (int k = 0; k < layer->count; k++) {
+        SolverClass c = layer->classes[k];
+        double reach = layer->reach[k];
+        int hpMax = layer->hpMax[k], fought = layer->fought[k];
+        if (!r->hasMonster) {
+            solverAddItems(solver, room, &c, reach, hpMax, fought);
+            continue;
+        }
+        SolverClass killed;
+        int hpBonus = solverKill(&c, r->monster, &killed);
+        solverAddItems(solver, room, &killed, reach, hpMax + hpBonus, fought);
+        // A sleeping monster (1/2) sneaked past (1/2) leaves the player as they were
+        if (solver->allowSneak) solverAddItems(solver, room, &c, reach * 0.25, hpMax, 0);
+    }
+    solverLayerPrune(&solver->layers[room + 1]);
+}
+
+// Drops unlikely classes and sets the layer's maxHp
+void solverLayerPrune(SolverLayer* layer) {
+    double minReach = SOLVER_EPSILON;
+    if (layer->count > SOLVER_MAX_CLASSES) {
+        double* sorted = malloc(sizeof(double) * layer->count);
+        memcpy(sorted, layer->reach, sizeof(double) * layer->count);
+        qsort(sorted, layer->count, sizeof(double), solverCompareReach);
+        if (sorted[SOLVER_MAX_CLASSES - 1] > minReach) minReach = sorted[SOLVER_MAX_CLASSES - 1];
+        free(sorted);
+    }
+    int kept = 0;
+    layer->maxHp = 0;
+    for (int k = 0; k < layer->count; k++) {
+        if (!layer->fought[k] && (layer->reach[k] < minReach || kept >= SOLVER_MAX_CLASSES)) continue;
+        layer->classes[kept] = layer->classes[k];
+        layer->reach[kept] = layer->reach[k];
+        layer->hpMax[kept] = layer->hpMax[k];
+        layer->fought[kept] = layer->fought[k];
+        if (layer->hpMax[k] > layer->maxHp) layer->maxHp = layer->hpMax[k];
+        kept++;
+    }
+    if (kept < layer->count) {
+        layer->count = kept;
+        solverLayerReindex(layer);
+    }
+}
+
+// Sorts reach from likely to unlikely
+int solverCompareReach(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x < y) - (x > y);
+}
+
+// Items are picked up on entering, like in the game: one of four bonuses at random
+void solverAddItems(Solver* solver, int room, const SolverClass* c, double reach, int hpMax, int fought) {
+    SolverLayer* next = &solver->layers[room + 1];
+    Room* r = &solver->rooms[room];
+    if (!r->hasItem) {
+        solverLayerFind(next, c, reach, hpMax, fought);
+        return;
+    }
+    const LootBand* band = &lootBands[lootBand(room)];
+    for (int k = 0; k < numLootItems; k++) {
+        const ItemDelta* d = &lootItems[k].delta;
+        if (band->prob[k] <= 0.0 || hpMax + d->hp <= 0) continue;
+        SolverClass item = *c;
+        item.damage += d->damage;
+        item.defense += d->defense;
+        item.speed += d->speed;
+        solverLayerFind(next, &item, reach * band->prob[k], hpMax + d->hp, fought);
+    }
+}
+
+// Kill bonus and level-ups as in bitwiseCombat and levelUp; returns the HP gained
+int solverKill(const SolverClass* c, const Monster* m, SolverClass* out) {
+    *out = *c;
+    int hpBonus = 1, expToNextLevel = 100 + 10 * (c->level - 1);
+    out->experience += m->xp;
+    out->damage += 1;
+    out->defense += 1;
+    out->speed += 1;
+    while (out->experience >= expToNextLevel) {
+        out->level++;
+        hpBonus += 10;
+        out->damage += 5;
+        out->defense += 5;
+        out->speed += 5;
+        out->experience -= expToNextLevel;
+        expToNextLevel += 10;
+    }
+    return hpBonus;
+}
+
+// Fills value[class][hp]. A fight taken with hp is won after i hits with prob[i]
+// as long as i * hpLoss < hp, so the fight row is a sum of shifted after-fight rows.
+void solverBackwardTask(void* arg) {
+    SolverTask* task = (SolverTask*)arg;
+    Solver* solver = task->solver;
+    SolverLayer* layer = &solver->layers[task->room];
+    Room* r = &solver->rooms[task->room];
+    task->fight = realloc(task->fight, sizeof(double) * (layer->maxHp + 1));
+
+    for (int k = task->first; k < task->last; k++) {
+        const SolverClass* c = &layer->classes[k];
+        double* row = &layer->value[layer->offset[k]];
+        int maxHp = layer->hpMax[k], rowSize = maxHp + 1;
+        if (!r->hasMonster) {
+            solverAfterMonster(task, task->room, c, row, maxHp);
+            continue;
+        }
+
+        SolverClass killed;
+        int hpBonus = solverKill(c, r->monster, &killed);
+        if (maxHp + hpBonus + 1 > task->afterSize) {
+            task->afterSize = maxHp + hpBonus + 1;
+            task->after = realloc(task->after, sizeof(double) * task->afterSize);
+        }
+        double* after = task->after;
+        solverAfterMonster(task, task->room, &killed, after, maxHp + hpBonus);
+        Player player = {maxHp, c->damage, c->speed, c->defense, c->level, c->experience, 0, NULL, NULL};
+        combatOutcome(&player, r->monster, &task->outcome);
+
+        double* fight = task->fight;
+        for (int hp = 0; hp <= maxHp; hp++) fight[hp] = 0.0;
+        int hpLoss = task->outcome.hpLoss;
+        for (int i = 0; i < task->outcome.count; i++) {
+            double p = task->outcome.prob[i];
+            if (p < SOLVER_EPSILON * SOLVER_EPSILON) continue;
+            const double* shifted = after + hpBonus - i * hpLoss;
+            for (int hp = i * hpLoss + 1; hp <= maxHp; hp++) fight[hp] += p * shifted[hp];
+        }
+
+        if (!solver->allowSneak || r->hasTreasure) {
+            memcpy(row, fight, sizeof(double) * rowSize);
+            continue;
+        }
+        // Sleeping (1/2): sneak works half the time, else fight anyway; pick the better per HP
+        solverAfterMonster(task, task->room, c, row, maxHp);
+        for (int hp = 0; hp <= maxHp; hp++) {
+            double sneak = 0.5 * row[hp] + 0.5 * fight[hp];
+            row[hp] = 0.5 * fight[hp] + 0.5 * (sneak > fight[hp] ? sneak : fight[hp]);
+        }
+    }
+}
+
+// row[hp] = survival chance after dealing with room's monster, for hp = 0..maxHp
+void solverAfterMonster(SolverTask* task, int room, const SolverClass* c, double* row, int maxHp) {
+    Solver* solver = task->solver;
+    Room* r = &solver->rooms[room];
+    row[0] = 0.0;
+    if (r->hasTreasure) {
+        for (int hp = 1; hp <= maxHp; hp++) row[hp] = 1.0;
+        return;
+    }
+    SolverLayer* next = &solver->layers[room + 1];
+    if (!r->hasItem) {
+        const double* same = solverRow(next, c);
+        for (int hp = 1; hp <= maxHp; hp++) row[hp] = same ? same[hp] : 0.0;
+        return;
+    }
+    for (int hp = 1; hp <= maxHp; hp++) row[hp] = 0.0;
+    const LootBand* band = &lootBands[lootBand(room)];
+    for (int k = 0; k < numLootItems; k++) {
+        const ItemDelta* d = &lootItems[k].delta;
+        if (band->prob[k] <= 0.0) continue;
+        SolverClass item = *c;
+        item.damage += d->damage;
+        item.defense += d->defense;
+        item.speed += d->speed;
+        const double* after = solverRow(next, &item);
+        if (!after) continue;
+        for (int hp = d->hp < 0 ? 1 - d->hp : 1; hp <= maxHp; hp++) row[hp] += band->prob[k] * after[hp + d->hp];
+    }
+}
+
+// HP row of a class in a valued layer, NULL if the class was dropped
+const double* solverRow(SolverLayer* layer, const SolverClass* c) {
+    int k = solverLayerFind(layer, c, 0.0, 0, 0);
+    return k >= 0 ? &layer->value[layer->offset[k]] : NULL;
+}
+
+// Index of c in the layer (-1 if missing). With reach > 0 the class is inserted
+// or the reach, HP bound and fought flag merged into it.
+int solverLayerFind(SolverLayer* layer, const SolverClass* c, double reach, int hpMax, int fought) {
+    int insert = reach > 0.0;
+    if (insert && (layer->count + 1) * 2 > layer->indexSize) solverLayerReindex(layer);
+    if (!layer->indexSize) return -1;
+
+    int slot = (int)(solverClassHash(c) & (uint64_t)(layer->indexSize - 1));
+    while (layer->index[slot]) {
+        int k = layer->index[slot] - 1;
+        if (memcmp(&layer->classes[k], c, sizeof(SolverClass)) == 0) {
+            if (insert) {
+                layer->reach[k] += reach;
+                if (hpMax > layer->hpMax[k]) layer->hpMax[k] = hpMax;
+                layer->fought[k] |= fought;
+            }
+            return k;
+        }
+        slot = (slot + 1) & (layer->indexSize - 1);
+    }
+    if (!insert) return -1;
+
+    if (layer->count == layer->capacity) {
+        layer->capacity = layer->capacity ? layer->capacity * 2 : 256;
+        layer->classes = realloc(layer->classes, sizeof(SolverClass) * layer->capacity);
+        layer->reach = realloc(layer->reach, sizeof(double) * layer->capacity);
+        layer->hpMax = realloc(layer->hpMax, sizeof(int) * layer->capacity);
+        layer->fought = realloc(layer->fought, layer->capacity);
+    }
+    layer->reach[layer->count] = reach;
+    layer->hpMax[layer->count] = hpMax;
+    layer->fought[layer->count] = (char)fought;
+    layer->classes[layer->count] = *c;
+    layer->index[slot] = ++layer->count;
+    return layer->count - 1;
+}
+
+// Rebuilds the hash index, at least twice as large as the class count
+void solverLayerReindex(SolverLayer* layer) {
+    int size = 1024;
+    while (size < (layer->count + 1) * 2) size *= 2;
+    free(layer->index);
+    layer->index = calloc(size, sizeof(int));
+    layer->indexSize = size;
+    for (int k = 0; k < layer->count; k++) {
+        int slot = (int)(solverClassHash(&layer->classes[k]) & (uint64_t)(size - 1));
+        while (layer->index[slot]) slot = (slot + 1) & (size - 1);
+        layer->index[slot] = k + 1;
+    }
+}
+
+uint64_t solverClassHash(const SolverClass* c) {
+    return mix64(((uint64_t)c->damage << 48) ^ ((uint64_t)c->defense << 32) ^ ((uint64_t)c->speed << 16) ^
+                 ((uint64_t)c->level << 56) ^ (uint64_t)c->experience);
+}
+
+void solverLayerFree(SolverLayer* layer) {
+    free(layer->classes);
+    free(layer->reach);
+    free(layer->hpMax);
+    free(layer->fought);
+    free(layer->offset);
+    free(layer->value);
+    free(layer->index);
+    memset(layer, 0, sizeof(SolverLayer));
+}
+
+void botInit(Bot* bot, int depth) {
+    memset(bot, 0, sizeof(Bot));
+    bot->depth = depth;
+    bot->cache = calloc(BOT_CACHE_SIZE, sizeof(BotEntry));
+    bot->paths = calloc(BOT_PATH_CACHE, sizeof(BotPath));
+}
+
+// New dungeon: bump the stamp instead of clearing the cache
+void botStartGame(Bot* bot, Room* rooms, int numRooms) {
+    bot->rooms = rooms;
+    bot->numRooms = numRooms;
+    bot->stamp++;
+    if (numRooms > bot->pathCapacity) {
+        bot->pathCapacity = numRooms;
+        for (int i = 0; i < BOT_PATH_CACHE; i++) {
+            bot->paths[i].margin = realloc(bot->paths[i].margin, sizeof(double) * numRooms);
+            bot->paths[i].scale = realloc(bot->paths[i].scale, sizeof(double) * numRooms);
+        }
+    }
+}
+
+void botFree(Bot* bot) {
+    free(bot->cache);
+    for (int i = 0; i < BOT_PATH_CACHE; i++) {
+        free(bot->paths[i].margin);
+        free(bot->paths[i].scale);
+    }
+    free(bot->paths);
+    for (int d = 0; d <= BOT_MAX_DEPTH; d++) free(bot->outcome[d].prob);
+}
+
+// Sneak when that gives the better survival chance. The bot only walks forward:
+// the dungeon is a chain and the rooms behind hold nothing new.
+int botChooseSneak(Player* player, void* arg) {
+    Bot* bot = (Bot*)arg;
+    playerStats(player);
+    SolverClass c = {player->damage, player->defense, player->speed, player->level, player->experience};
+    int room = player->currentRoom->id;
+    bot->decisions++;
+    double fight = botFight(bot, &c, player->hp, room, bot->depth);
+    double sneak = 0.5 * botAfterMonster(bot, &c, player->hp, room, bot->depth) + 0.5 * fight;
+    LOG("🤖 Bot kiest %s\n", sneak > fight ? "sluipen" : "vechten");
+    return sneak > fight;
+}
+
+// Expectimax value of entering room: chance nodes for sleeping, sneaking, fights
+// and items, the better of fight or sneak where the player gets to choose.
+// After depth rooms botEstimate takes over.
+double botValue(Bot* bot, const SolverClass* c, int hp, int room, int depth) {
+    Room* r = &bot->rooms[room];
+    if (r->hasTreasure && !r->hasMonster) return 1.0;
+
+    BotKey key = {*c, hp, room, depth};
+    BotEntry* e = &bot->cache[mix64(solverClassHash(c) ^ ((uint64_t)hp << 40) ^ ((uint64_t)room << 20) ^ (uint64_t)depth) &
+                              (BOT_CACHE_SIZE - 1)];
+    bot->lookups++;
+    if (e->stamp == bot->stamp && memcmp(&e->key, &key, sizeof(BotKey)) == 0) {
+        bot->hits++;
+        return e->value;
+    }
+
+    double value;
+    if (depth == 0) {
+        value = botEstimate(bot, c, hp, room);
+    } else if (!r->hasMonster) {
+        value = botAfterMonster(bot, c, hp, room, depth);
+    } else {
+        value = botFight(bot, c, hp, room, depth);
+        if (!r->hasTreasure) {
+            double sneak = 0.5 * botAfterMonster(bot, c, hp, room, depth) + 0.5 * value;
+            value = 0.5 * value + 0.5 * (sneak > value ? sneak : value);
+        }
+    }
+    e->key = key;
+    e->value = value;
+    e->stamp = bot->stamp;
+    return value;
+}
+
+double botFight(Bot* bot, const SolverClass* c, int hp, int room, int depth) {
+    Monster* m = bot->rooms[room].monster;
+    CombatOutcome* out = &bot->outcome[depth];
+    Player player = {hp, c->damage, c->speed, c->defense, c->level, c->experience, 0, NULL, NULL};
+    combatOutcome(&player, m, out);
+
+    SolverClass killed;
+    int hpBonus = solverKill(c, m, &killed);
+    double value = 0.0;
+    for (int i = 0; i < out->count; i++) {
+        if (out->prob[i] < BOT_EPSILON) continue;
+        value += out->prob[i] * botAfterMonster(bot, &killed, hp - i * out->hpLoss + hpBonus, room, depth);
+    }
+    return value;
+}
+
+// Item pickup and the walk to the next room, one level deeper
+double botAfterMonster(Bot* bot, const SolverClass* c, int hp, int room, int depth) {
+    Room* r = &bot->rooms[room];
+    if (r->hasTreasure) return 1.0;
+    if (!r->hasItem) return botValue(bot, c, hp, room + 1, depth - 1);
+
+    const LootBand* band = &lootBands[lootBand(room)];
+    double value = 0.0;
+    for (int k = 0; k < numLootItems; k++) {
+        const ItemDelta* d = &lootItems[k].delta;
+        if (band->prob[k] <= 0.0 || hp + d->hp <= 0) continue;
+        SolverClass item = *c;
+        item.damage += d->damage;
+        item.defense += d->defense;
+        item.speed += d->speed;
+        value += band->prob[k] * botValue(bot, &item, hp + d->hp, room + 1, depth - 1);
+    }
+    return value;
+}
+
+// Rough survival chance from room on when every monster is fought and items count as
+// their average bonus. The damage taken so far is treated as normal and the fight
+// where it most likely runs out of HP decides.
+double botEstimate(Bot* bot, const SolverClass* c, int hp, int room) {
+    BotPath* path = botPath(bot, c, room);
+    if (!path->fights) return 1.0;
+    double worst = (hp + path->margin[0]) * path->scale[0];
+    for (int f = 1; f < path->fights; f++) {
+        double z = (hp + path->margin[f]) * path->scale[f];
+        if (z < worst) worst = z;
+    }
+    return 0.5 * erfc(-worst / sqrt(2.0));
+}
+
+// The fights ahead of c, cached per game. The hits taken in a fight are negative
+// binomial: mean k(1-q)/q and variance k(1-q)/q^2.
+BotPath* botPath(Bot* bot, const SolverClass* c, int room) {
+    BotPath* path = &bot->paths[mix64(solverClassHash(c) ^ (uint64_t)room) & (BOT_PATH_CACHE - 1)];
+    if (path->stamp == bot->stamp && path->room == room && memcmp(&path->c, c, sizeof(SolverClass)) == 0) return path;
+    path->c = *c;
+    path->room = room;
+    path->stamp = bot->stamp;
+    path->fights = 0;
+
+    CombatOutcome* out = &bot->outcome[0];
+    SolverClass now = *c;
+    double mean = 0.0, var = 0.0, bonus = 0.0;
+    for (int r = room; r < bot->numRooms; r++) {
+        Room* rm = &bot->rooms[r];
+        if (rm->hasMonster) {
+            Player player = {1, now.damage, now.speed, now.defense, now.level, now.experience, 0, NULL, NULL};
+            combatOutcome(&player, rm->monster, out);
+            double missed = out->hitsToKill * (1.0 - out->q) / out->q;
+            mean += missed * out->hpLoss;
+            var += missed / out->q * out->hpLoss * out->hpLoss;
+            path->margin[path->fights] = bonus - 0.5 - mean;
+            path->scale[path->fights++] = 1.0 / sqrt(var);
+            SolverClass killed;
+            bonus += solverKill(&now, rm->monster, &killed);
+            now = killed;
+        }
+        if (rm->hasTreasure) break;
+        if (rm->hasItem) {
+            const LootBand* band = &lootBands[lootBand(r)];
+            bonus += band->meanHp;
+            now.damage += (int)band->meanDamage;
+            now.defense += (int)band->meanDefense;
+            now.speed += (int)band->meanSpeed;
+        }
+    }
+    return path;
+}
+
+void fightCacheInit(FightCache* cache) {
+    memset(cache, 0, sizeof(FightCache));
+    cache->entries = calloc(FIGHT_CACHE_SIZE, sizeof(FightEntry));
+    for (int i = 0; i < FIGHT_CACHE_STRIPES; i++) mutexInit(&cache->locks[i]);
+}
+
+void fightCacheFree(FightCache* cache) {
+    for (int i = 0; i < FIGHT_CACHE_SIZE; i++) free(cache->entries[i].outcome.prob);
+    for (int i = 0; i < FIGHT_CACHE_STRIPES; i++) mutexFree(&cache->locks[i]);
+    free(cache->entries);
+}
+
+// Hits the player takes in a fight, for u uniform in [0, 1); the number of hits that
+// kills the player means they lost. A miss, or an entry made for less HP, computes
+// the outcome with combatOutcome into the slot.
+int fightCacheSample(FightCache* cache, const Player* player, const Monster* m, double u) {
+    int monsterDmg = m->attack - player->defense;
+    if (monsterDmg < 1) monsterDmg = 1;
+    int deathHits = (player->hp + monsterDmg - 1) / monsterDmg;
+    FightKey key = {player->damage, player->defense, player->speed, m->hp, m->attack, m->defense, m->speed};
+    uint64_t hash = mix64(((uint64_t)(uint32_t)key.damage << 32) ^ ((uint64_t)(uint32_t)key.defense << 16) ^
+                          (uint64_t)(uint32_t)key.speed) ^
+                    mix64(((uint64_t)(uint32_t)key.monsterHp << 48) ^ ((uint64_t)(uint32_t)key.monsterAttack << 32) ^
+                          ((uint64_t)(uint32_t)key.monsterDefense << 16) ^ (uint64_t)(uint32_t)key.monsterSpeed);
+    int slot = (int)(hash & (FIGHT_CACHE_SIZE - 1)), stripe = slot & (FIGHT_CACHE_STRIPES - 1);
+
+    mutexLock(&cache->locks[stripe]);
+    FightEntry* e = &cache->entries[slot];
+    if (e->used && e->outcome.count >= deathHits && memcmp(&e->key, &key, sizeof(FightKey)) == 0) {
+        cache->hits[stripe]++;
+    } else {
+        cache->misses[stripe]++;
+        combatOutcome(player, m, &e->outcome);
+        for (int i = 1; i < e->outcome.count; i++) e->outcome.prob[i] += e->outcome.prob[i - 1];
+        e->key = key;
+        e->used = 1;
+    }
+    int lo = 0, hi = deathHits;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (u < e->outcome.prob[mid]) hi = mid;
+        else lo = mid + 1;
+    }
+    mutexUnlock(&cache->locks[stripe]);
+    return lo;
+}
+
+// Remaining-HP distribution of the fight in one room for a new player, from the
+// Markov DP, checked against the closed form
+void showFight(Room* rooms, int numRooms, int room) {
+    if (room >= numRooms || !rooms[room].hasMonster) {
+        printf("❌ Geen monster in kamer %d.\n", room);
+        return;
+    }
+    Monster* m = rooms[room].monster;
+    Player player = {100, 10, 10, 10, 1, 0, 100, &rooms[room], NULL};
+    CombatOutcome markov = {0}, closed = {0};
+    combatMarkov(&player, m, FIGHT_EPSILON, &markov);
+    combatOutcome(&player, m, &closed);
+
+    printf("🔹 Gevecht in kamer %d: %s HP=%d, ATK=%d tegen Speler HP=%d\n", room,
+           m->type == GOBLIN ? "Goblin" : "Orc", m->hp, m->attack, player.hp);
+    printf("  Winkans: %.6f%% (%d aanvallen, nog %.1e onbeslist)\n", 100.0 * markov.win, markov.attacks,
+           markov.unresolved);
+    printf("  HP over   kans\n");
+    double diff = 0.0;
+    for (int i = 0; i < markov.count; i++) {
+        double d = fabs(markov.prob[i] - closed.prob[i]);
+        if (d > diff) diff = d;
+        if (markov.prob[i] >= 1e-6) printf("  %6d   %.6f\n", player.hp - i * markov.hpLoss, markov.prob[i]);
+    }
+    printf("  Grootste verschil met de gesloten vorm: %.1e\n", diff);
+    free(markov.prob);
+    free(closed.prob);
+}
+
+// Same rooms as generateDungeonSeeded for the seed, in pages
+void worldCreate(World* world, int numRooms, uint64_t seed) {
+    int numPages = (numRooms + WORLD_PAGE_ROOMS - 1) / WORLD_PAGE_ROOMS;
+    world->table = malloc(sizeof(WorldTable) + sizeof(WorldPage*) * numPages);
+    world->table->refs = 1;
+    world->table->numPages = numPages;
+    world->numRooms = numRooms;
+    world->pagesCopied = 0;
+    world->bytesCopied = 0;
+    for (int p = 0; p < numPages; p++) {
+        WorldPage* page = malloc(sizeof(WorldPage));
+        page->refs = 1;
+        world->table->pages[p] = page;
+        for (int k = 0; k < WORLD_PAGE_ROOMS; k++) {
+            int i = p * WORLD_PAGE_ROOMS + k;
+            WorldRoom* r = &page->rooms[k];
+            memset(r, 0, sizeof(WorldRoom));
+            for (int d = 0; d < 4; d++) r->links[d] = -1;
+            if (i >= numRooms) continue;
+            roomLinks(seed, i, numRooms, r->links);
+            r->hasMonster = roomRandom(seed, i, STREAM_MONSTER) & 1;
+            r->hasItem = roomRandom(seed, i, STREAM_ITEM) & 1;
+            r->hasTreasure = i == numRooms - 1;
+            if (r->hasMonster) rollMonster(&r->monster, i, &balance);
+            r->events = roomEvents(r->hasMonster);
+        }
+    }
+}
+
+// O(1): the clone shares the whole page table until either side writes
+void worldClone(const World* world, World* clone) {
+    world->table->refs++;
+    clone->table = world->table;
+    clone->numRooms = world->numRooms;
+    clone->pagesCopied = 0;
+    clone->bytesCopied = 0;
+}
+
+void worldFree(World* world) {
+    WorldTable* table = world->table;
+    world->table = NULL;
+    if (--table->refs > 0) return;
+    for (int p = 0; p < table->numPages; p++) {
+        if (--table->pages[p]->refs == 0) free(table->pages[p]);
+    }
+    free(table);
+}
+
+const WorldRoom* worldRoom(const World* world, int room) {
+    return &world->table->pages[room / WORLD_PAGE_ROOMS]->rooms[room % WORLD_PAGE_ROOMS];
+}
+
+// Writable room: a shared page table and then a shared page are copied first
+WorldRoom* worldEdit(World* world, int room) {
+    WorldTable* table = world->table;
+    if (table->refs > 1) {
+        size_t size = sizeof(WorldTable) + sizeof(WorldPage*) * table->numPages;
+        WorldTable* own = malloc(size);
+        memcpy(own, table, size);
+        own->refs = 1;
+        for (int p = 0; p < own->numPages; p++) own->pages[p]->refs++;
+        table->refs--;
+        world->table = table = own;
+        world->bytesCopied += size;
+    }
+    WorldPage** page = &table->pages[room / WORLD_PAGE_ROOMS];
+    if ((*page)->refs > 1) {
+        WorldPage* own = malloc(sizeof(WorldPage));
+        memcpy(own, *page, sizeof(WorldPage));
+        own->refs = 1;
+        (*page)->refs--;
+        *page = own;
+        world->pagesCopied++;
+        world->bytesCopied += sizeof(WorldPage);
+    }
+    return &(*page)->rooms[room % WORLD_PAGE_ROOMS];
+}
+
+// playHeadless for a world: walks on from *room until the game ends or stopRoom is
+// entered. Each room is resolved by resolveRoom on a copy and only written back
+// (copying its page) when something in it changed.
+TurnResult worldPlay(World* world, Player* player, int* room, int stopRoom) {
+    while (*room != stopRoom) {
+        const WorldRoom* r = worldRoom(world, *room);
+        Monster m = r->monster;
+        Room view = {*room, r->hasMonster, r->hasItem, r->hasTreasure, r->visited,
+                     {NULL, NULL, NULL, NULL}, r->hasMonster ? &m : NULL, r->events};
+        player->currentRoom = &view;
+        TurnResult result = resolveRoom(player, NULL, NULL);
+        player->currentRoom = NULL;
+        if (view.hasMonster != r->hasMonster || view.hasItem != r->hasItem || !r->visited || m.hp != r->monster.hp) {
+            WorldRoom* w = worldEdit(world, *room);
+            w->hasMonster = view.hasMonster;
+            w->hasItem = view.hasItem;
+            w->visited = 1;
+            w->monster = m;
+            r = w;
+        }
+        if (result != TURN_CONTINUE) return result;
+        int next = -1;
+        for (int d = 0; d < 4; d++) {
+            if (r->links[d] == *room + 1) next = *room + 1;
+        }
+        if (next < 0) return TURN_DIED;
+        *room = next;
+        if (moveTick(player, next) == TURN_DIED) return TURN_DIED;
+    }
+    return TURN_CONTINUE;
+}
+
+// What-if run: one game walks to forkRoom, then numBranches forks of it play on with
+// their own random streams, all sharing the untouched pages
+void runForks(int numRooms, int numBranches, int forkRoom, uint64_t seed) {
+    if (numRooms < 2) numRooms = 2;
+    if (forkRoom < 0 || forkRoom >= numRooms) forkRoom = 0;
+    clock_t start = clock();
+    World trunk;
+    worldCreate(&trunk, numRooms, seed);
+    printf("🔹 Wereld van %d kamers (%d pagina's) gemaakt in %.2fs\n", numRooms, trunk.table->numPages,
+           (double)(clock() - start) / CLOCKS_PER_SEC);
+
+    quietMode = 1;
+    rngSeed(seed);
+    Player player = {100, 10, 10, 10, 1, 0, 100, NULL, NULL};
+    int room = 0;
+    if (worldPlay(&trunk, &player, &room, forkRoom) != TURN_CONTINUE) {
+        quietMode = 0;
+        printf("❌ Het spel eindigt voor kamer %d; kies een eerdere --forkat.\n", forkRoom);
+        worldFree(&trunk);
+        return;
+    }
+
+    World* branches = malloc(sizeof(World) * numBranches);
+    start = clock();
+    for (int b = 0; b < numBranches; b++) worldClone(&trunk, &branches[b]);
+    double cloneSeconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    int wins = 0;
+    long long roomSum = 0, pagesCopied = 0, bytesCopied = 0;
+    for (int b = 0; b < numBranches; b++) {
+        Player p = player;
+        int at = room;
+        rngSeed(mix64(seed + 1 + (uint64_t)b));
+        if (worldPlay(&branches[b], &p, &at, -1) == TURN_WON) wins++;
+        roomSum += at;
+        pagesCopied += branches[b].pagesCopied;
+        bytesCopied += branches[b].bytesCopied;
+    }
+    quietMode = 0;
+
+    double fullMb = (sizeof(WorldTable) + trunk.table->numPages * (sizeof(WorldPage*) + sizeof(WorldPage))) / 1048576.0;
+    printf("🔹 %d vertakkingen vanaf kamer %d: %.3f µs per kopie\n", numBranches, forkRoom,
+           1e6 * cloneSeconds / numBranches);
+    printf("  Gewonnen: %d, gemiddeld tot kamer %.1f\n", wins, (double)roomSum / numBranches);
+    printf("  Geheugen: %.1f MB gekopieerd (%lld pagina's) tegen %.1f MB voor volledige kopieën\n",
+           bytesCopied / 1048576.0, pagesCopied, numBranches * fullMb);
+    for (int b = 0; b < numBranches; b++) worldFree(&branches[b]);
+    free(branches);
+    worldFree(&trunk);
+}
+
+void populationInit(Population* pop, int candidates, int trials) {
+    pop->candidates = candidates;
+    pop->trials = trials;
+    pop->count = candidates * trials;
+    int** fields[] = {&pop->hp, &pop->damage, &pop->speed, &pop->defense, &pop->level, &pop->experience,
+                      &pop->expToNextLevel, &pop->itemHp, &pop->itemDamage, &pop->itemDefense, &pop->itemSpeed,
+                      &pop->alive, &pop->itemRoll};
+    for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) *fields[f] = calloc(pop->count, sizeof(int));
+}
+
+void populationFree(Population* pop) {
+    int* fields[] = {pop->hp, pop->damage, pop->speed, pop->defense, pop->level, pop->experience,
+                     pop->expToNextLevel, pop->itemHp, pop->itemDamage, pop->itemDefense, pop->itemSpeed,
+                     pop->alive, pop->itemRoll};
+    for (size_t f = 0; f < sizeof(fields) / sizeof(fields[0]); f++) free(fields[f]);
+}
+
+// All lanes of the shard walk the dungeon room by room, like playHeadless without
+// sneaking. Fights are drawn per lane from the fight cache; the stat updates after
+// them are branch-free loops over the lanes.
+void populationShardRun(void* arg) {
+    PopulationShard* shard = (PopulationShard*)arg;
+    Population* pop = shard->pop;
+    int lo = shard->first * pop->trials, hi = shard->last * pop->trials, columns = shard->numRooms + 1;
+    int* hp = pop->hp;
+    int* damage = pop->damage;
+    int* speed = pop->speed;
+    int* defense = pop->defense;
+    int* level = pop->level;
+    int* experience = pop->experience;
+    int* expToNextLevel = pop->expToNextLevel;
+    int* alive = pop->alive;
+    int* roll = pop->itemRoll;
+
+    for (int r = 0; r < shard->numRooms; r++) {
+        Room* room = &shard->rooms[r];
+        int any = 0;
+        for (int i = lo; i < hi; i++) {
+            shard->survivors[(i / pop->trials) * columns + r] += alive[i];
+            any |= alive[i];
+        }
+        if (!any) break;
+        if (room->hasTreasure && !room->hasMonster) {
+            for (int i = lo; i < hi; i++) shard->survivors[(i / pop->trials) * columns + shard->numRooms] += alive[i];
+            break;
+        }
+
+        if (room->hasMonster) {
+            Monster* m = room->monster;
+            for (int i = lo; i < hi; i++) {
+                if (!alive[i]) continue;
+                Player player = {hp[i], damage[i], speed[i], defense[i], level[i], experience[i], expToNextLevel[i], NULL, NULL};
+                int monsterDmg = m->attack - defense[i];
+                if (monsterDmg < 1) monsterDmg = 1;
+                double u = (double)(roomRandom(shard->seed + (uint64_t)i, r, STREAM_FIGHT) >> 11) / 9007199254740992.0;
+                hp[i] -= fightCacheSample(fightCache, &player, m, u) * monsterDmg;
+                alive[i] = hp[i] > 0;
+            }
+            int xp = m->xp;
+            for (int i = lo; i < hi; i++) {
+                int won = alive[i];
+                experience[i] += won * xp;
+                hp[i] += won;
+                damage[i] += won;
+                defense[i] += won;
+                speed[i] += won;
+            }
+            int levelling = 1;
+            while (levelling) {
+                levelling = 0;
+                for (int i = lo; i < hi; i++) {
+                    int up = alive[i] & (experience[i] >= expToNextLevel[i]);
+                    level[i] += up;
+                    hp[i] += 10 * up;
+                    damage[i] += 5 * up;
+                    defense[i] += 5 * up;
+                    speed[i] += 5 * up;
+                    experience[i] -= up * expToNextLevel[i];
+                    expToNextLevel[i] += 10 * up;
+                    levelling |= up;
+                }
+            }
+        }
+
+        if (room->hasTreasure) {
+            for (int i = lo; i < hi; i++) shard->survivors[(i / pop->trials) * columns + shard->numRooms] += alive[i];
+            break;
+        }
+        if (room->hasItem) {
+            // Same alias draw as getItem, from the band of this room
+            const LootBand* band = &lootBands[lootBand(r)];
+            for (int i = lo; i < hi; i++) {
+                uint64_t x = roomRandom(shard->seed + (uint64_t)i, r, STREAM_PICKUP);
+                int k = (int)(((x >> 32) * (uint64_t)numLootItems) >> 32);
+                roll[i] = (uint32_t)x >= band->threshold[k] ? band->alias[k] : k;
+            }
+            for (int i = lo; i < hi; i++) {
+                int live = alive[i];
+                const ItemDelta* d = &lootItems[roll[i]].delta;
+                hp[i] += live * d->hp * pop->itemHp[i] / POP_ITEM_HP;
+                damage[i] += live * d->damage * pop->itemDamage[i] / POP_ITEM_STAT;
+                defense[i] += live * d->defense * pop->itemDefense[i] / POP_ITEM_STAT;
+                speed[i] += live * d->speed * pop->itemSpeed[i] / POP_ITEM_STAT;
+                alive[i] = live & (hp[i] > 0);  // a --loot item can cost HP
+            }
+        }
+    }
+}
+
+// Candidate 0 is the current game; the others vary the start stats and item bonuses.
+// Prints the survival curve of the default and the best candidates.
+void runPopulation(int candidates, int trials, uint64_t seed, int numThreads) {
+    if (trials < 1) trials = 1;
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > candidates) numThreads = candidates;
+    int numRooms = 50, columns = numRooms + 1;
+    Room* rooms = generateDungeonSeeded(numRooms, seed, numThreads);
+    Population pop;
+    populationInit(&pop, candidates, trials);
+
+    rngSeed(mix64(seed));
+    for (int c = 0; c < candidates; c++) {
+        int start[7] = {100, 10, 10, 10, POP_ITEM_HP, POP_ITEM_STAT, POP_ITEM_STAT};
+        if (c > 0) {
+            start[0] = 60 + (int)(rngNext64() % 81);
+            for (int f = 1; f < 4; f++) start[f] = 5 + (int)(rngNext64() % 11);
+            start[4] = 10 + (int)(rngNext64() % 21);
+            start[5] = 2 + (int)(rngNext64() % 7);
+            start[6] = 2 + (int)(rngNext64() % 7);
+        }
+        for (int i = c * trials; i < (c + 1) * trials; i++) {
+            pop.hp[i] = start[0];
+            pop.damage[i] = start[1];
+            pop.defense[i] = start[2];
+            pop.speed[i] = start[3];
+            pop.level[i] = 1;
+            pop.experience[i] = 0;
+            pop.expToNextLevel[i] = 100;
+            pop.itemHp[i] = start[4];
+            pop.itemDamage[i] = start[5];
+            pop.itemDefense[i] = start[5];
+            pop.itemSpeed[i] = start[6];
+            pop.alive[i] = 1;
+        }
+    }
+    // Start values, kept before the run changes the lanes
+    int* start = malloc(sizeof(int) * candidates * 7);
+    for (int c = 0; c < candidates; c++) {
+        int i = c * trials;
+        int values[7] = {pop.hp[i], pop.damage[i], pop.defense[i], pop.speed[i], pop.itemHp[i], pop.itemDamage[i], pop.itemSpeed[i]};
+        memcpy(&start[c * 7], values, sizeof(values));
+    }
+
+    int* survivors = calloc((size_t)candidates * columns, sizeof(int));
+    PopulationShard* shards = malloc(sizeof(PopulationShard) * numThreads);
+    for (int t = 0; t < numThreads; t++) {
+        shards[t].pop = &pop;
+        shards[t].rooms = rooms;
+        shards[t].numRooms = numRooms;
+        shards[t].first = (int)((long long)candidates * t / numThreads);
+        shards[t].last = (int)((long long)candidates * (t + 1) / numThreads);
+        shards[t].seed = mix64(seed + 1);
+        shards[t].survivors = survivors;
+    }
+    FightCache cache;
+    fightCacheInit(&cache);
+    fightCache = &cache;
+    clock_t begin = clock();
+    runParallel(populationShardRun, shards, sizeof(PopulationShard), numThreads);
+    double seconds = (double)(clock() - begin) / CLOCKS_PER_SEC;
+    fightCache = NULL;
+    fightCacheFree(&cache);
+
+    printf("🔹 Populatie: %d kandidaten x %d spellen in dungeon %llu (%.2fs CPU)\n", candidates, trials,
+           (unsigned long long)seed, seconds);
+    printf("  Kand.   HP DMG DEF SPD | item HP  DMG/DEF SPD | levend in kamer 10    20    30    40 | wint\n");
+    int shown[11], numShown = 0;
+    shown[numShown++] = 0;
+    for (int n = 0; n < 10 && n < candidates - 1; n++) {
+        int best = -1;
+        for (int c = 1; c < candidates; c++) {
+            int taken = 0;
+            for (int k = 0; k < numShown; k++) taken |= shown[k] == c;
+            if (!taken && (best < 0 || survivors[c * columns + numRooms] > survivors[best * columns + numRooms])) best = c;
+        }
+        shown[numShown++] = best;
+    }
+    for (int k = 0; k < numShown; k++) {
+        int c = shown[k];
+        const int* v = &start[c * 7];
+        const int* curve = &survivors[c * columns];
+        printf("  %5d  %3d %3d %3d %3d |      %3d  %3d     %3d |            %5.1f%% %5.1f%% %5.1f%% %5.1f%% | %5.1f%%\n", c,
+               v[0], v[1], v[2], v[3], v[4], v[5], v[6], 100.0 * curve[10] / trials, 100.0 * curve[20] / trials,
+               100.0 * curve[30] / trials, 100.0 * curve[40] / trials, 100.0 * curve[numRooms] / trials);
+    }
+    free(shards);
+    free(survivors);
+    free(start);
+    populationFree(&pop);
+    freeDungeon(rooms, numRooms);
+}
+
+// Lines of "name value", # starts a comment; unknown names are skipped
+int loadBalance(const char* file, Balance* b) {
+    FILE* f = fopen(file, "r");
+    if (!f) return 0;
+    char line[128], name[32];
+    float value;
+    int found = 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || sscanf(line, "%31s %f", name, &value) != 2) continue;
+        for (int k = 0; k < 6; k++) {
+            if (strcmp(name, balanceNames[k]) == 0) {
+                *(float*)((char*)b + balanceOffset[k]) = value;
+                found++;
+            }
+        }
+    }
+    fclose(f);
+    return found > 0;
+}
+
+void saveBalance(const char* file, const TuneTask* best) {
+    FILE* f = fopen(file, "w");
+    if (!f) {
+        printf("❌ Balans kan niet opgeslagen worden in %s.\n", file);
+        return;
+    }
+    fprintf(f, "# Monsterbalans van --tune; laden met --balance %s\n", file);
+    for (int k = 0; k < 6; k++) {
+        fprintf(f, "%s %.4f\n", balanceNames[k], *(const float*)((const char*)&best->balance + balanceOffset[k]));
+    }
+    for (int band = 0; band < best->numTargets; band++) {
+        if (band < TUNE_BANDS - 1) fprintf(f, "# levend in kamer %d: ", 10 * (band + 1));
+        else fprintf(f, "# wint: ");
+        fprintf(f, "doel %.1f%%, behaald %.1f%%\n", best->targets[band], best->alive[band]);
+    }
+    fclose(f);
+}
+
+// Plays the candidate's games headless; game g uses the same seeds for every
+// candidate, so differences come from the balance and not from luck
+void tuneEvaluate(void* arg) {
+    TuneTask* task = (TuneTask*)arg;
+    WorldPool pool;
+    poolInit(&pool, 50);
+    int alive[TUNE_BANDS] = {0};
+    for (int g = 0; g < task->games; g++) {
+        uint64_t gameSeed = mix64(task->seed + (uint64_t)g);
+        Room* rooms = poolGenerateDungeon(&pool, 50, gameSeed, &task->balance);
+        rngSeed(gameSeed);
+        Player player = {100, 10, 10, 10, 1, 0, 100, NULL, NULL};
+        int won = playHeadless(&player, rooms, NULL, NULL) == TURN_WON;
+        int reached = won ? 50 : player.currentRoom->id;
+        for (int band = 0; band < TUNE_BANDS - 1; band++) alive[band] += reached >= 10 * (band + 1);
+        alive[TUNE_BANDS - 1] += won;
+    }
+    poolFree(&pool);
+    task->error = 0.0;
+    for (int band = 0; band < TUNE_BANDS; band++) {
+        task->alive[band] = 100.0 * alive[band] / task->games;
+        if (band < task->numTargets) {
+            double miss = task->alive[band] - task->targets[band];
+            task->error += miss * miss;
+        }
+    }
+}
+
+// Log of a balance value, kept inside balanceMin..balanceMax
+double tuneClamp(int field, double logValue) {
+    double lo = log(balanceMin[field]), hi = log(balanceMax[field]);
+    return logValue < lo ? lo : logValue > hi ? hi : logValue;
+}
+
+int tuneCompare(const void* a, const void* b) {
+    double x = ((const TuneTask*)a)->error, y = ((const TuneTask*)b)->error;
+    return (x > y) - (x < y);
+}
+
+// Evolution strategy over the log of the balance values with a step size per value:
+// every generation samples TUNE_LAMBDA candidates around the mean, plays them on
+// numThreads threads and moves the mean and step sizes towards the better half. targets: alive percentages like "60,40,25,15,10".
+void runTune(const char* targets, uint64_t seed, int numThreads) {
+    double goal[TUNE_BANDS];
+    int numTargets = 0;
+    const char* p = targets;
+    while (numTargets < TUNE_BANDS && *p) {
+        char* end;
+        goal[numTargets] = strtod(p, &end);
+        if (end == p) break;
+        numTargets++;
+        p = *end == ',' ? end + 1 : end;
+    }
+    if (!numTargets) {
+        printf("❌ Geen doelen in \"%s\".\n", targets);
+        return;
+    }
+    if (numThreads < 1) numThreads = 1;
+
+    double mean[6], sigma[6];
+    for (int k = 0; k < 6; k++) {
+        float start = *(const float*)((const char*)&balance + balanceOffset[k]);
+        mean[k] = tuneClamp(k, log(start > 0 ? start : balanceMin[k]));
+        sigma[k] = 0.3;
+    }
+    TuneTask tasks[TUNE_LAMBDA], best = {0};
+    best.error = -1.0;
+    uint64_t draws = mix64(seed ^ 0x5475E3ULL);
+    FightCache cache;
+    fightCacheInit(&cache);
+    fightCache = &cache;
+    quietMode = 1;
+    clock_t begin = clock();
+
+    for (int gen = 0; gen < TUNE_GENERATIONS; gen++) {
+        for (int c = 0; c < TUNE_LAMBDA; c++) {
+            TuneTask* t = &tasks[c];
+            for (int k = 0; k < 6; k++) {
+                // Box-Muller normal from two uniform draws
+                double u1 = ((double)(mix64(draws++) >> 11) + 1.0) / 9007199254740993.0;
+                double u2 = (double)(mix64(draws++) >> 11) / 9007199254740992.0;
+                t->logValues[k] = tuneClamp(k, mean[k] + sigma[k] * sqrt(-2.0 * log(u1)) * cos(6.283185307179586 * u2));
+                *(float*)((char*)&t->balance + balanceOffset[k]) = (float)exp(t->logValues[k]);
+            }
+            t->targets = goal;
+            t->numTargets = numTargets;
+            t->games = TUNE_GAMES;
+            t->seed = seed;
+        }
+        for (int first = 0; first < TUNE_LAMBDA; first += numThreads) {
+            int count = TUNE_LAMBDA - first < numThreads ? TUNE_LAMBDA - first : numThreads;
+            runParallel(tuneEvaluate, &tasks[first], sizeof(TuneTask), count);
+        }
+        qsort(tasks, TUNE_LAMBDA, sizeof(TuneTask), tuneCompare);
+        if (best.error < 0.0 || tasks[0].error < best.error) best = tasks[0];
+
+        // Rank-weighted mean of the better half; each value's step size becomes how far
+        // those candidates spread from the old mean in that value, so values the error
+        // is sensitive to narrow down and the others keep exploring
+        for (int k = 0; k < 6; k++) {
+            double weightSum = 0.0, moved = 0.0, spread = 0.0;
+            for (int c = 0; c < TUNE_LAMBDA / 2; c++) {
+                double w = log(TUNE_LAMBDA / 2 + 0.5) - log(c + 1.0), d = tasks[c].logValues[k] - mean[k];
+                weightSum += w;
+                moved += w * d;
+                spread += w * d * d;
+            }
+            mean[k] = tuneClamp(k, mean[k] + moved / weightSum);
+            sigma[k] = sqrt(0.5 * sigma[k] * sigma[k] + 0.5 * spread / weightSum);
+            if (sigma[k] < TUNE_MIN_SIGMA) sigma[k] = TUNE_MIN_SIGMA;
+        }
+        printf("🔹 Generatie %2d: fout %7.2f  HP %.1f ATK %.1f DEF %.1f SPD %.1f XP %.1f groei %.3f\n", gen + 1,
+               best.error, best.balance.hp, best.balance.attack, best.balance.defense, best.balance.speed,
+               best.balance.xp, best.balance.growth);
+    }
+    quietMode = 0;
+    fightCache = NULL;
+    fightCacheFree(&cache);
+
+    best.targets = goal;
+    printf("🔹 Aanbevolen balans (%.1fs CPU), opgeslagen in %s\n", (double)(clock() - begin) / CLOCKS_PER_SEC,
+           BALANCE_FILE);
+    for (int band = 0; band < numTargets; band++) {
+        if (band < TUNE_BANDS - 1) printf("  Levend in kamer %d: doel %.1f%%, behaald %.1f%%\n", 10 * (band + 1), goal[band], best.alive[band]);
+        else printf("  Wint: doel %.1f%%, behaald %.1f%%\n", goal[band], best.alive[band]);
+    }
+    saveBalance(BALANCE_FILE, &best);
+}
+
+void sessionInit(Session* session, int numRooms, uint64_t seed) {
+    int words = (numRooms + 63) / 64;
+    session->cleared = calloc(3 * words, sizeof(uint64_t));
+    session->taken = session->cleared + words;
+    session->visited = session->taken + words;
+    session->hurt = NULL;
+    session->numHurt = session->hurtCapacity = 0;
+    Player start = {100, 10, 10, 10, 1, 0, 100, NULL, NULL};
+    session->player = start;
+    session->room = 0;
+    session->rng = seed;
+    session->result = TURN_CONTINUE;
+}
+
+void sessionFree(Session* session) {
+    free(session->cleared);
+    free(session->hurt);
+}
+
+int sessionMonsterHp(const Session* session, int room, int baseHp) {
+    for (int i = 0; i < session->numHurt; i++) {
+        if (session->hurt[i].room == room) return session->hurt[i].hp;
+    }
+    return baseHp;
+}
+
+void sessionHurtMonster(Session* session, int room, int hp) {
+    for (int i = 0; i < session->numHurt; i++) {
+        if (session->hurt[i].room == room) {
+            session->hurt[i].hp = hp;
+            return;
+        }
+    }
+    if (session->numHurt == session->hurtCapacity) {
+        session->hurtCapacity = session->hurtCapacity ? 2 * session->hurtCapacity : 1;
+        session->hurt = realloc(session->hurt, sizeof(HpEntry) * session->hurtCapacity);
+    }
+    session->hurt[session->numHurt].room = room;
+    session->hurt[session->numHurt].hp = hp;
+    session->numHurt++;
+}
+
+// resolveRoom for one session on a view of the template room with the session's
+// changes applied, then a step towards the treasure. The changes are stored back
+// in the overlay; the session's random stream is swapped in, so sessions can be
+// interleaved.
+TurnResult sessionStep(Session* session, Room* dungeon) {
+    Room* room = &dungeon[session->room];
+    int id = room->id;
+    Room view = *room;
+    Monster m;
+    view.hasMonster = room->hasMonster && !BIT_GET(session->cleared, id);
+    view.hasItem = room->hasItem && !BIT_GET(session->taken, id);
+    view.visited = BIT_GET(session->visited, id) != 0;
+    if (view.hasMonster) {
+        m = *room->monster;
+        m.hp = sessionMonsterHp(session, id, m.hp);
+        view.monster = &m;
+    }
+
+    uint64_t outerRng = rngState;
+    rngState = session->rng;
+    Player* player = &session->player;
+    player->currentRoom = &view;
+    session->result = resolveRoom(player, NULL, NULL);
+    BIT_SET(session->visited, id);
+    if (room->hasMonster && !view.hasMonster) BIT_SET(session->cleared, id);
+    else if (view.hasMonster && m.hp != room->monster->hp) sessionHurtMonster(session, id, m.hp);
+    if (room->hasItem && !view.hasItem) BIT_SET(session->taken, id);
+
+    if (session->result == TURN_CONTINUE) {
+        Room* next = forwardRoom(room);
+        if (!next) {
+            session->result = TURN_DIED;
+        } else {
+            session->room = next->id;
+            session->result = moveTick(player, next->id);
+        }
+    }
+    player->currentRoom = NULL;
+    session->rng = rngState;
+    rngState = outerRng;
+    return session->result;
+}
+
+// Server-style run: numSessions players on the same seed, one room per session per
+// tick, all reading one dungeon template
+void runSessions(int numSessions, uint64_t seed) {
+    int numRooms = 50;
+    Room* dungeon = generateDungeonSeeded(numRooms, seed, 1);
+    Session* sessions = malloc(sizeof(Session) * numSessions);
+    for (int s = 0; s < numSessions; s++) sessionInit(&sessions[s], numRooms, mix64(seed + 1 + (uint64_t)s));
+
+    quietMode = 1;
+    clock_t start = clock();
+    int running = numSessions, ticks = 0;
+    while (running > 0) {
+        running = 0;
+        for (int s = 0; s < numSessions; s++) {
+            if (sessions[s].result == TURN_CONTINUE && sessionStep(&sessions[s], dungeon) == TURN_CONTINUE) running++;
+        }
+        ticks++;
+    }
+    quietMode = 0;
+
+    int wins = 0, numMonsters = 0;
+    long long roomSum = 0, overlayBytes = 0;
+    for (int i = 0; i < numRooms; i++) numMonsters += dungeon[i].hasMonster;
+    for (int s = 0; s < numSessions; s++) {
+        wins += sessions[s].result == TURN_WON;
+        roomSum += sessions[s].room;
+        overlayBytes += 3 * ((numRooms + 63) / 64) * sizeof(uint64_t) + sessions[s].hurtCapacity * sizeof(HpEntry);
+    }
+    double copyBytes = (double)numRooms * sizeof(Room) + numMonsters * sizeof(Monster);
+    printf("🔹 %d sessies op seed %llu: %d ticks, %.2fs CPU\n", numSessions, (unsigned long long)seed, ticks,
+           (double)(clock() - start) / CLOCKS_PER_SEC);
+    printf("  Gewonnen: %d (%.1f%%), gemiddeld tot kamer %.1f\n", wins, 100.0 * wins / numSessions,
+           (double)roomSum / numSessions);
+    printf("  Geheugen per sessie: %.1f bits per kamer tegen %.1f bytes per kamer voor een eigen kopie\n",
+           8.0 * overlayBytes / numSessions / numRooms, copyBytes / numRooms);
+    for (int s = 0; s < numSessions; s++) sessionFree(&sessions[s]);
+    free(sessions);
+    freeDungeon(dungeon, numRooms);
+}
+
+// The room streams of generateDungeonSeeded, without building the rooms
+void seedSummarize(uint64_t seed, int numRooms, SeedSummary* out) {
+    out->monsters = out->items = 0;
+    for (int i = 0; i < numRooms && i < 64; i++) {
+        out->monsters |= (roomRandom(seed, i, STREAM_MONSTER) & 1) << i;
+        out->items |= (roomRandom(seed, i, STREAM_ITEM) & 1) << i;
+    }
+}
+
+int summaryMatches(const SeedSummary* summary, const SeedQuery* q) {
+    uint64_t freeMask = q->freeRooms >= 64 ? ~0ULL : (1ULL << q->freeRooms) - 1;
+    return !(summary->monsters & freeMask) && popcount64(summary->items) >= q->minItems &&
+           popcount64(summary->monsters) <= q->maxMonsters;
+}
+
+// Rolls rooms one at a time and stops as soon as the query can no longer match
+int seedMatches(uint64_t seed, int numRooms, const SeedQuery* q, long long* roomsRolled) {
+    int items = 0, monsters = 0;
+    for (int i = 0; i < numRooms; i++) {
+        (*roomsRolled)++;
+        int monster = (int)(roomRandom(seed, i, STREAM_MONSTER) & 1);
+        if (monster && (i < q->freeRooms || ++monsters > q->maxMonsters)) return 0;
+        items += (int)(roomRandom(seed, i, STREAM_ITEM) & 1);
+        if (items + numRooms - 1 - i < q->minItems) return 0;
+    }
+    return 1;
+}
+
+// "free=5,items=25,monsters=20"; missing keys don't restrict anything
+int parseSeedQuery(const char* spec, SeedQuery* q) {
+    q->freeRooms = 0;
+    q->minItems = 0;
+    q->maxMonsters = 64;
+    const char* p = spec;
+    while (*p) {
+        char key[16];
+        int value, used;
+        if (sscanf(p, "%15[a-z]=%d%n", key, &value, &used) != 2) return 0;
+        if (strcmp(key, "free") == 0) q->freeRooms = value;
+        else if (strcmp(key, "items") == 0) q->minItems = value;
+        else if (strcmp(key, "monsters") == 0) q->maxMonsters = value;
+        else return 0;
+        p += used;
+        if (*p == ',') p++;
+    }
+    return 1;
+}
+
+void catalogChunkRun(void* arg) {
+    SeedChunk* c = (SeedChunk*)arg;
+    for (int k = 0; k < c->count; k++) seedSummarize(c->first + (uint64_t)k, c->numRooms, &c->summaries[k]);
+}
+
+void searchChunkRun(void* arg) {
+    SeedChunk* c = (SeedChunk*)arg;
+    c->numFound = 0;
+    c->roomsRolled = 0;
+    for (int k = 0; k < c->count; k++) {
+        uint64_t seed = c->first + (uint64_t)k;
+        if (!seedMatches(seed, c->numRooms, c->query, &c->roomsRolled)) continue;
+        if (c->numFound < CATALOG_SHOW) c->found[c->numFound] = seed;
+        c->numFound++;
+    }
+}
+
+// Index: header (magic, rooms, first seed, count), then one SeedSummary per seed
+void buildCatalog(uint64_t first, int count, int numThreads) {
+    int numRooms = 50;
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > count) numThreads = count;
+    SeedSummary* summaries = malloc(sizeof(SeedSummary) * count);
+    SeedChunk* chunks = calloc(numThreads, sizeof(SeedChunk));
+    clock_t start = clock();
+    for (int t = 0; t < numThreads; t++) {
+        int from = (int)((long long)count * t / numThreads), to = (int)((long long)count * (t + 1) / numThreads);
+        chunks[t].summaries = summaries + from;
+        chunks[t].first = first + (uint64_t)from;
+        chunks[t].count = to - from;
+        chunks[t].numRooms = numRooms;
+    }
+    runParallel(catalogChunkRun, chunks, sizeof(SeedChunk), numThreads);
+
+    FILE* f = fopen(CATALOG_FILE, "wb");
+    if (f) {
+        uint32_t header[2] = {CATALOG_MAGIC, (uint32_t)numRooms};
+        uint64_t range[2] = {first, (uint64_t)count};
+        fwrite(header, sizeof(header), 1, f);
+        fwrite(range, sizeof(range), 1, f);
+        fwrite(summaries, sizeof(SeedSummary), count, f);
+        fclose(f);
+        printf("🔹 Catalogus van %d seeds (%llu-%llu) opgeslagen in %s: %.1f MB, %.2fs CPU\n", count,
+               (unsigned long long)first, (unsigned long long)(first + count - 1), CATALOG_FILE,
+               (double)count * sizeof(SeedSummary) / 1048576.0, (double)(clock() - start) / CLOCKS_PER_SEC);
+    } else {
+        printf("❌ Catalogus kan niet opgeslagen worden in %s.\n", CATALOG_FILE);
+    }
+    free(chunks);
+    free(summaries);
+}
+
+// Answers from the index when there is one, otherwise searches count seeds from
+// first with early exit
+void findSeeds(const char* spec, uint64_t first, int count, int numThreads) {
+    SeedQuery q;
+    if (!parseSeedQuery(spec, &q)) {
+        printf("❌ Onbekende zoekvraag \"%s\" (bijv. free=5,items=25,monsters=20).\n", spec);
+        return;
+    }
+    int numRooms = 50, numFound = 0;
+    uint64_t found[CATALOG_SHOW];
+    clock_t start = clock();
+
+    FILE* f = fopen(CATALOG_FILE, "rb");
+    uint32_t header[2];
+    uint64_t range[2];
+    if (f && fread(header, sizeof(header), 1, f) == 1 && header[0] == CATALOG_MAGIC &&
+        (int)header[1] == numRooms && fread(range, sizeof(range), 1, f) == 1) {
+        SeedSummary block[4096];
+        uint64_t seed = range[0];
+        size_t n;
+        while ((n = fread(block, sizeof(SeedSummary), 4096, f)) > 0) {
+            for (size_t k = 0; k < n; k++, seed++) {
+                if (!summaryMatches(&block[k], &q)) continue;
+                if (numFound < CATALOG_SHOW) found[numFound] = seed;
+                numFound++;
+            }
+        }
+        printf("🔹 %d van %llu seeds in %s voldoen (%.2fs CPU)\n", numFound, (unsigned long long)range[1],
+               CATALOG_FILE, (double)(clock() - start) / CLOCKS_PER_SEC);
+    } else {
+        if (numThreads < 1) numThreads = 1;
+        if (numThreads > count) numThreads = count;
+        SeedChunk* chunks = calloc(numThreads, sizeof(SeedChunk));
+        for (int t = 0; t < numThreads; t++) {
+            int from = (int)((long long)count * t / numThreads), to = (int)((long long)count * (t + 1) / numThreads);
+            chunks[t].query = &q;
+            chunks[t].first = first + (uint64_t)from;
+            chunks[t].count = to - from;
+            chunks[t].numRooms = numRooms;
+        }
+        runParallel(searchChunkRun, chunks, sizeof(SeedChunk), numThreads);
+        long long roomsRolled = 0;
+        for (int t = 0; t < numThreads; t++) {
+            for (int k = 0; k < chunks[t].numFound && k < CATALOG_SHOW && numFound + k < CATALOG_SHOW; k++) {
+                found[numFound + k] = chunks[t].found[k];
+            }
+            numFound += chunks[t].numFound;
+            roomsRolled += chunks[t].roomsRolled;
+        }
+        printf("🔹 %d van %d seeds voldoen; gemiddeld %.1f van %d kamers gerold (%.2fs CPU)\n", numFound, count,
+               (double)roomsRolled / count, numRooms, (double)(clock() - start) / CLOCKS_PER_SEC);
+        free(chunks);
+    }
+    if (f) fclose(f);
+    for (int k = 0; k < numFound && k < CATALOG_SHOW; k++) printf("  Seed %llu\n", (unsigned long long)found[k]);
+}
+
+void encounterInit(Encounter* e, int capacity) {
+    e->actors = malloc(sizeof(Combatant) * capacity);
+    e->heap = malloc(sizeof(int) * capacity);
+    e->alive[0] = malloc(sizeof(int) * capacity);
+    e->alive[1] = malloc(sizeof(int) * capacity);
+    e->capacity = capacity;
+    e->numActors = e->heapSize = 0;
+    e->numAlive[0] = e->numAlive[1] = 0;
+    e->leader = -1;
+    e->actions = 0;
+}
+
+void encounterFree(Encounter* e) {
+    free(e->actors);
+    free(e->heap);
+    free(e->alive[0]);
+    free(e->alive[1]);
+}
+
+// The first action comes at a random point of the actor's own interval, so equal
+// speeds don't always act in the order they were added
+int encounterAdd(Encounter* e, const char* name, int number, int hp, int attack, int defense, int speed, int side) {
+    if (e->numActors == e->capacity) return -1;
+    int id = e->numActors++;
+    Combatant* c = &e->actors[id];
+    c->name = name;
+    c->number = number;
+    c->hp = hp;
+    c->attack = attack;
+    c->defense = defense;
+    c->speed = speed < 1 ? 1 : speed > INITIATIVE_SCALE ? INITIATIVE_SCALE : speed;
+    c->side = side;
+    c->slot = e->numAlive[side];
+    e->alive[side][e->numAlive[side]++] = id;
+    c->nextTime = (long long)(rngNext64() % (uint64_t)(INITIATIVE_SCALE / c->speed));
+    initiativePush(e, id);
+    return id;
+}
+
+// Earlier action first; ties go to the actor added first
+int encounterBefore(const Encounter* e, int a, int b) {
+    long long ta = e->actors[a].nextTime, tb = e->actors[b].nextTime;
+    return ta < tb || (ta == tb && a < b);
+}
+
+void initiativePush(Encounter* e, int actor) {
+    int i = e->heapSize++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!encounterBefore(e, actor, e->heap[parent])) break;
+        e->heap[i] = e->heap[parent];
+        i = parent;
+    }
+    e->heap[i] = actor;
+}
+
+int initiativePop(Encounter* e) {
+    int top = e->heap[0], last = e->heap[--e->heapSize], i = 0;
+    while (1) {
+        int child = 2 * i + 1;
+        if (child >= e->heapSize) break;
+        if (child + 1 < e->heapSize && encounterBefore(e, e->heap[child + 1], e->heap[child])) child++;
+        if (!encounterBefore(e, e->heap[child], last)) break;
+        e->heap[i] = e->heap[child];
+        i = child;
+    }
+    if (e->heapSize) e->heap[i] = last;
+    return top;
+}
+
+// Fights until one side is down or side 0 lost its leader; every action hits a random
+// living enemy with the damage and dodge rules of bitwiseCombat. Returns the winning side.
+int encounterRun(Encounter* e) {
+    while (e->numAlive[0] && e->numAlive[1] && (e->leader < 0 || e->actors[e->leader].slot >= 0)) {
+        int id = initiativePop(e);
+        Combatant* c = &e->actors[id];
+        if (c->slot < 0) continue;
+        int enemySide = 1 - c->side;
+        uint64_t r = rngNext64();
+        int targetId = e->alive[enemySide][((r >> 32) * (uint64_t)e->numAlive[enemySide]) >> 32];
+        Combatant* target = &e->actors[targetId];
+        if (dodgeRoll(target->speed - c->speed)) {
+            LOG("🛡️ %s %d ontwijkt %s %d.\n", target->name, target->number, c->name, c->number);
+        } else {
+            int dmg = c->attack - target->defense;
+            if (dmg < 1) dmg = 1;
+            target->hp -= dmg;
+            LOG("⚔️ %s %d doet %d schade aan %s %d. HP: %d\n", c->name, c->number, dmg, target->name, target->number,
+                target->hp);
+            if (target->hp <= 0) {
+                int* alive = e->alive[enemySide];
+                int moved = alive[--e->numAlive[enemySide]];
+                alive[target->slot] = moved;
+                e->actors[moved].slot = target->slot;
+                target->slot = -1;
+                LOG("☠️  %s %d valt.\n", target->name, target->number);
+            }
+        }
+        e->actions++;
+        c->nextTime += INITIATIVE_SCALE / c->speed;
+        initiativePush(e, id);
+    }
+    return e->numAlive[1] ? 1 : 0;
+}
+
+// The player and numAllies allies with starting stats against numMonsters monsters
+// of the given room; the fight is lost when the player falls. Small encounters show
+// the first fight.
+void runEncounters(int numMonsters, int numAllies, int room, uint64_t seed) {
+    if (numAllies < 0) numAllies = 0;
+    if (room < 0) room = 0;
+    Monster m;
+    rollMonster(&m, room, &balance);
+    const char* monsterName = m.type == GOBLIN ? "Goblin" : "Orc";
+    int numActors = 1 + numAllies + numMonsters, wins = 0;
+    long long actions = 0;
+    Encounter e;
+    encounterInit(&e, numActors);
+    rngSeed(seed);
+    clock_t start = clock();
+    for (int g = 0; g < ENCOUNTER_GAMES; g++) {
+        quietMode = g > 0 || numActors > 4;
+        e.numActors = e.heapSize = 0;
+        e.numAlive[0] = e.numAlive[1] = 0;
+        e.actions = 0;
+        e.leader = encounterAdd(&e, "Speler", 1, 100, 10, 10, 10, 0);
+        for (int a = 0; a < numAllies; a++) encounterAdd(&e, "Bondgenoot", a + 1, 100, 10, 10, 10, 0);
+        for (int k = 0; k < numMonsters; k++) encounterAdd(&e, monsterName, k + 1, m.hp, m.attack, m.defense, m.speed, 1);
+        wins += encounterRun(&e) == 0;
+        actions += e.actions;
+    }
+    quietMode = 0;
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("🔹 %d gevechten: Speler en %d bondgenoten tegen %d× %s uit kamer %d\n", ENCOUNTER_GAMES, numAllies,
+           numMonsters, monsterName, room);
+    printf("  Gewonnen: %.1f%%, gemiddeld %.0f acties, %.0f ns per actie\n", 100.0 * wins / ENCOUNTER_GAMES,
+           (double)actions / ENCOUNTER_GAMES, actions ? 1e9 * seconds / actions : 0.0);
+    encounterFree(&e);
+}
+
+int packFight(const Room* room) {
+    return room->monster->count > 1 || packAllies > 0;
+}
+
+// A room's pack and the allies on the initiative heap, led by the player: the fight
+// is lost when the player falls. Allies join with starting stats every fight; each
+// monster of the pack gives its XP and kill bonus.
+void encounterCombat(Player* player) {
+    playerStats(player);
+    Monster* m = player->currentRoom->monster;
+    const char* monsterName = m->type == GOBLIN ? "Goblin" : "Orc";
+    int startHp = player->hp;
+    Encounter e;
+    encounterInit(&e, 1 + packAllies + m->count);
+    e.leader = encounterAdd(&e, "Speler", 1, player->hp, player->damage, player->defense, player->speed, 0);
+    for (int a = 0; a < packAllies; a++) encounterAdd(&e, "Bondgenoot", a + 1, 100, 10, 10, 10, 0);
+    for (int k = 0; k < m->count; k++) encounterAdd(&e, monsterName, k + 1, m->hp, m->attack, m->defense, m->speed, 1);
+    if (packAllies) LOG("👥 Speler en %d bondgenoten tegen %d× %s.\n", packAllies, m->count, monsterName);
+    else LOG("👹 Speler vecht tegen %d× %s.\n", m->count, monsterName);
+    int won = encounterRun(&e) == 0;
+    player->hp = e.actors[e.leader].hp;
+    encounterFree(&e);
+    if (runStats) {
+        if (won) statsAdd(runStats, HIST_DAMAGE_DEALT, m->hp * m->count);
+        statsAdd(runStats, HIST_DAMAGE_TAKEN, startHp - (player->hp > 0 ? player->hp : 0));
+    }
+    if (won) {
+        for (int k = 0; k < m->count; k++) defeatMonster(player, m);
+        m->hp = 0;
+    } else {
+        LOG("☠️  Speler is verslagen...\n");
+    }
+}
+
+void wheelInit(StatusWheel* w) {
+    for (int l = 0; l < WHEEL_LEVELS; l++) {
+        for (int k = 0; k < WHEEL_SLOTS; k++) w->slots[l][k] = -1;
+    }
+    for (int i = 0; i < STATUS_MAX_EFFECTS; i++) w->effects[i].next = i + 1 < STATUS_MAX_EFFECTS ? i + 1 : -1;
+    w->freeList = 0;
+    w->numActive = 0;
+    w->playerStunned = 0;
+    w->now = 0;
+}
+
+// O(1): head of the level 0 slot of its tick, or of the level 1 slot of its block
+void wheelPlace(StatusWheel* w, int id) {
+    StatusEffect* e = &w->effects[id];
+    int near = e->due - w->now < WHEEL_SLOTS;
+    e->level = near ? 0 : 1;
+    e->slot = (int)(near ? e->due % WHEEL_SLOTS : (e->due / WHEEL_SLOTS) % WHEEL_SLOTS);
+    int* head = &w->slots[e->level][e->slot];
+    e->prev = -1;
+    e->next = *head;
+    if (*head >= 0) w->effects[*head].prev = id;
+    *head = id;
+}
+
+void wheelUnlink(StatusWheel* w, int id) {
+    StatusEffect* e = &w->effects[id];
+    if (e->prev >= 0) w->effects[e->prev].next = e->next;
+    else w->slots[e->level][e->slot] = e->next;
+    if (e->next >= 0) w->effects[e->next].prev = e->prev;
+}
+
+// One combat round or move. At the start of a block its level 1 slot is spread
+// over level 0, then the effects due now fire.
+void wheelTick(StatusWheel* w) {
+    w->now++;
+    if (w->now % WHEEL_SLOTS == 0) {
+        int* head = &w->slots[1][(w->now / WHEEL_SLOTS) % WHEEL_SLOTS];
+        int id = *head;
+        *head = -1;
+        while (id >= 0) {
+            int next = w->effects[id].next;
+            wheelPlace(w, id);
+            id = next;
+        }
+    }
+    int* head = &w->slots[0][w->now % WHEEL_SLOTS];
+    int id = *head;
+    *head = -1;
+    while (id >= 0) {
+        int next = w->effects[id].next;
+        effectFire(w, id);
+        id = next;
+    }
+}
+
+// Returns the effect's id, or -1 when the wheel is full
+int effectAdd(StatusWheel* w, EffectType type, const char* target, int* hp, int* stunned, int amount, int period, int count) {
+    if (w->freeList < 0) return -1;
+    int id = w->freeList;
+    StatusEffect* e = &w->effects[id];
+    w->freeList = e->next;
+    w->numActive++;
+    e->type = type;
+    e->target = target;
+    e->hp = hp;
+    e->stunned = stunned;
+    e->amount = amount;
+    e->period = period < 1 ? 1 : period > WHEEL_MAX_DELAY ? WHEEL_MAX_DELAY : period;
+    e->left = count;
+    e->due = w->now + e->period;
+    if (stunned) (*stunned)++;
+    wheelPlace(w, id);
+    return id;
+}
+
+void effectFire(StatusWheel* w, int id) {
+    StatusEffect* e = &w->effects[id];
+    if (e->type == EFFECT_POISON && *e->hp > 0) {
+        *e->hp -= e->amount;
+        LOG("🤢 Gif doet %d schade aan %s. HP: %d\n", e->amount, e->target, *e->hp);
+    } else if (e->type == EFFECT_REGEN && *e->hp > 0) {
+        *e->hp += e->amount;
+        LOG("💚 %s herstelt %d HP. HP: %d\n", e->target, e->amount, *e->hp);
+    }
+    if (--e->left > 0) {
+        e->due = w->now + e->period;
+        wheelPlace(w, id);
+    } else {
+        effectRemove(w, id);
+    }
+}
+
+// The effect must already be out of its slot
+void effectRemove(StatusWheel* w, int id) {
+    StatusEffect* e = &w->effects[id];
+    if (e->stunned) (*e->stunned)--;
+    e->next = w->freeList;
+    w->freeList = id;
+    w->numActive--;
+}
+
+// Drops every effect on hp, e.g. on a monster when its fight ends
+void effectCancel(StatusWheel* w, const int* hp) {
+    for (int l = 0; l < WHEEL_LEVELS; l++) {
+        for (int k = 0; k < WHEEL_SLOTS; k++) {
+            int id = w->slots[l][k];
+            while (id >= 0) {
+                int next = w->effects[id].next;
+                if (w->effects[id].hp == hp) {
+                    wheelUnlink(w, id);
+                    effectRemove(w, id);
+                }
+                id = next;
+            }
+        }
+    }
+}
+
+// Each hit has a 1 in 4 chance to poison (Orc: 2 HP a tick for 3 ticks) or to
+// stun (Goblin); the stun is gone after two ticks, so it costs the next round
+void statusOnHit(StatusWheel* w, Player* player, const Monster* m, int hits) {
+    for (int h = 0; h < hits; h++) {
+        if (rngNext64() >> 62) continue;
+        if (m->type == ORC) {
+            LOG("☠️  Speler is vergiftigd!\n");
+            effectAdd(w, EFFECT_POISON, "Speler", &player->hp, NULL, 2, 1, 3);
+        } else if (!w->playerStunned) {
+            LOG("💫 Speler is verdoofd!\n");
+            effectAdd(w, EFFECT_STUN, "Speler", &player->hp, &w->playerStunned, 0, 2, 1);
+        }
+    }
+}
+
+// Links as in worldCreate; the caller places the count monsters with storePlace
+// and then sorts them by room with storeIndex
+void storeInit(MonsterStore* store, int numRooms, int count, uint64_t seed) {
+    store->count = count;
+    store->numRooms = numRooms;
+    store->current = 0;
+    store->seed = seed;
+    for (int c = 0; c < 2; c++) {
+        MonsterColumns* col = &store->columns[c];
+        col->room = malloc(sizeof(int) * count);
+        col->hp = malloc(sizeof(int) * count);
+        col->attack = malloc(sizeof(int) * count);
+        col->defense = malloc(sizeof(int) * count);
+        col->speed = malloc(sizeof(int) * count);
+        col->timer = malloc(sizeof(int) * count);
+        col->id = malloc(sizeof(uint32_t) * count);
+        col->state = malloc(count);
+    }
+    store->first = malloc(sizeof(int) * (numRooms + 1));
+    store->dest = malloc(sizeof(int) * count);
+    store->exits = malloc(sizeof(int[4]) * numRooms);
+    store->numExits = malloc(numRooms);
+    for (int i = 0; i < numRooms; i++) {
+        int links[4], n = 0;
+        roomLinks(seed, i, numRooms, links);
+        for (int d = 0; d < 4; d++) {
+            if (links[d] >= 0) store->exits[i][n++] = links[d];
+        }
+        store->numExits[i] = (uint8_t)n;
+    }
+
+}
+
+void storePlace(MonsterStore* store, int e, int room, const Monster* m) {
+    MonsterColumns* col = &store->columns[store->current];
+    col->room[e] = room;
+    col->hp[e] = m->hp;
+    col->attack[e] = m->attack;
+    col->defense[e] = m->defense;
+    col->speed[e] = m->speed;
+    col->timer[e] = 0;
+    col->id[e] = (uint32_t)e;
+    col->state[e] = AI_WANDERING;
+    store->dest[e] = room;
+}
+
+void storeIndex(MonsterStore* store) {
+    RoamChunk all = {store, 0, store->numRooms, 0, store->count, calloc(store->numRooms, sizeof(int)), 0, 0};
+    for (int e = 0; e < store->count; e++) all.counts[store->dest[e]]++;
+    storeSort(store, &all, 1);
+    free(all.counts);
+}
+
+void storeFree(MonsterStore* store) {
+    for (int c = 0; c < 2; c++) {
+        MonsterColumns* col = &store->columns[c];
+        free(col->room);
+        free(col->hp);
+        free(col->attack);
+        free(col->defense);
+        free(col->speed);
+        free(col->timer);
+        free(col->id);
+        free(col->state);
+    }
+    free(store->first);
+    free(store->dest);
+    free(store->exits);
+    free(store->numExits);
+}
+
+// Every monster decides in parallel over room chunks, then all are re-sorted by room
+void storeTick(MonsterStore* store, RoamChunk* chunks, int numChunks, uint64_t tick) {
+    for (int c = 0; c < numChunks; c++) chunks[c].tick = tick;
+    runParallel(roamDecide, chunks, sizeof(RoamChunk), numChunks);
+    storeSort(store, chunks, numChunks);
+}
+
+// Counting sort on dest: per room, the chunks write one after another in chunk
+// order, so entities keep their order within a room
+void storeSort(MonsterStore* store, RoamChunk* chunks, int numChunks) {
+    int next = 0;
+    for (int r = 0; r < store->numRooms; r++) {
+        store->first[r] = next;
+        for (int c = 0; c < numChunks; c++) {
+            int n = chunks[c].counts[r];
+            chunks[c].counts[r] = next;
+            next += n;
+        }
+    }
+    store->first[store->numRooms] = next;
+    runParallel(roamScatter, chunks, sizeof(RoamChunk), numChunks);
+    store->current = 1 - store->current;
+}
+
+// A resting monster counts down; a wandering one walks through a random
+// connection and then rests for a while, slower monsters longer
+void roamDecide(void* arg) {
+    RoamChunk* c = (RoamChunk*)arg;
+    MonsterStore* store = c->store;
+    MonsterColumns* col = &store->columns[store->current];
+    int* roomOf = col->room;
+    int* timer = col->timer;
+    int* speed = col->speed;
+    uint32_t* id = col->id;
+    uint8_t* state = col->state;
+    int* dest = store->dest;
+    int* counts = c->counts;
+    int from = store->first[c->firstRoom], to = store->first[c->lastRoom];
+    long long moved = 0;
+    memset(counts, 0, sizeof(int) * store->numRooms);
+    uint64_t tickSeed = mix64(store->seed + c->tick);
+    for (int e = from; e < to; e++) {
+        int room = roomOf[e];
+        if (timer[e] > 0) {
+            state[e] = --timer[e] ? AI_RESTING : AI_WANDERING;
+        } else {
+            uint64_t r = mix64(tickSeed ^ id[e]);
+            int n = store->numExits[room];
+            if (n) {
+                room = store->exits[room][((r & 0xFFFF) * (uint64_t)n) >> 16];
+                moved++;
+            }
+            int rest = (int)(r >> 16) & 1;
+            int span = 1 + 100 / (speed[e] > 1 ? speed[e] : 1);
+            timer[e] = rest * (1 + (int)(((r >> 32) * (uint64_t)span) >> 32));
+            state[e] = rest ? AI_RESTING : AI_WANDERING;
+        }
+        dest[e] = room;
+        counts[room]++;
+    }
+    c->from = from;
+    c->to = to;
+    c->moved += moved;
+}
+
+void roamScatter(void* arg) {
+    RoamChunk* c = (RoamChunk*)arg;
+    MonsterStore* store = c->store;
+    MonsterColumns* src = &store->columns[store->current];
+    MonsterColumns* dst = &store->columns[1 - store->current];
+    for (int e = c->from; e < c->to; e++) {
+        int room = store->dest[e], to = c->counts[room]++;
+        dst->room[to] = room;
+        dst->hp[to] = src->hp[e];
+        dst->attack[to] = src->attack[e];
+        dst->defense[to] = src->defense[e];
+        dst->speed[to] = src->speed[e];
+        dst->timer[to] = src->timer[e];
+        dst->id[to] = src->id[e];
+        dst->state[to] = src->state[e];
+    }
+}
+
+// count monsters roaming a dungeon of numRooms rooms for ROAM_TICKS ticks
+void runRoam(int count, int numRooms, uint64_t seed, int numThreads) {
+    if (numRooms < 2) numRooms = 2;
+    if (numThreads < 1) numThreads = 1;
+    if (numThreads > numRooms) numThreads = numRooms;
+    MonsterStore store;
+    clock_t start = clock();
+    storeInit(&store, numRooms, count, seed);
+    // Monsters start in random rooms with that room's stats
+    for (int e = 0; e < count; e++) {
+        Monster m;
+        int room = (int)(mix64(seed ^ (0xE17ULL << 40) ^ (uint64_t)e) % (uint64_t)numRooms);
+        rollMonster(&m, room, &balance);
+        storePlace(&store, e, room, &m);
+    }
+    storeIndex(&store);
+    printf("🔹 %d monsters in %d kamers geplaatst in %.2fs\n", count, numRooms, (double)(clock() - start) / CLOCKS_PER_SEC);
+
+    RoamChunk* chunks = calloc(numThreads, sizeof(RoamChunk));
+    for (int t = 0; t < numThreads; t++) {
+        chunks[t].store = &store;
+        chunks[t].firstRoom = (int)((long long)numRooms * t / numThreads);
+        chunks[t].lastRoom = (int)((long long)numRooms * (t + 1) / numThreads);
+        chunks[t].counts = malloc(sizeof(int) * numRooms);
+    }
+    struct timespec wallStart, wallEnd;
+    timespec_get(&wallStart, TIME_UTC);
+    for (int tick = 1; tick <= ROAM_TICKS; tick++) storeTick(&store, chunks, numThreads, (uint64_t)tick);
+    timespec_get(&wallEnd, TIME_UTC);
+    double seconds = (wallEnd.tv_sec - wallStart.tv_sec) + (wallEnd.tv_nsec - wallStart.tv_nsec) / 1e9;
+
+    long long moved = 0;
+    int busiest = 0;
+    for (int t = 0; t < numThreads; t++) {
+        moved += chunks[t].moved;
+        free(chunks[t].counts);
+    }
+    for (int r = 0; r < numRooms; r++) {
+        if (store.first[r + 1] - store.first[r] > busiest) busiest = store.first[r + 1] - store.first[r];
+    }
+    printf("  %d ticks (%d threads): %.2f ms per tick, %.1f%% van de monsters beweegt per tick\n", ROAM_TICKS,
+           numThreads, 1e3 * seconds / ROAM_TICKS, 100.0 * moved / ROAM_TICKS / count);
+    printf("  Drukste kamer: %d monsters\n", busiest);
+    free(chunks);
+    storeFree(&store);
+}
+
+// Every monster starts in its own room; none walks into the treasure room, so its
+// guard stays the only one there
+void wanderInit(Wander* w, Room* rooms, int numRooms, uint64_t seed) {
+    int count = 0;
+    for (int r = 0; r < numRooms; r++) count += rooms[r].hasMonster && !rooms[r].hasTreasure;
+    MonsterStore* store = &w->store;
+    storeInit(store, numRooms, count, seed);
+    w->rooms = rooms;
+    w->owner = malloc(sizeof(Monster*) * (count ? count : 1));
+    w->home = malloc(sizeof(Monster*) * numRooms);
+    w->tick = 0;
+    int e = 0;
+    for (int r = 0; r < numRooms; r++) {
+        w->home[r] = rooms[r].monster;
+        int n = 0;
+        for (int k = 0; k < store->numExits[r]; k++) {
+            if (!rooms[store->exits[r][k]].hasTreasure) store->exits[r][n++] = store->exits[r][k];
+        }
+        store->numExits[r] = (uint8_t)n;
+        if (rooms[r].hasMonster && !rooms[r].hasTreasure) {
+            w->owner[e] = rooms[r].monster;
+            storePlace(store, e++, r, rooms[r].monster);
+        }
+    }
+    storeIndex(store);
+    RoamChunk chunk = {store, 0, numRooms, 0, count, malloc(sizeof(int) * numRooms), 0, 0};
+    w->chunk = chunk;
+}
+
+// One tick per move. A room shows the first monster in it that is still alive, and
+// its events follow the monster like those of a generated room.
+void wanderTick(Wander* w) {
+    MonsterStore* store = &w->store;
+    storeTick(store, &w->chunk, 1, ++w->tick);
+    const uint32_t* id = store->columns[store->current].id;
+    for (int r = 0; r < store->numRooms; r++) {
+        Room* room = &w->rooms[r];
+        if (room->hasTreasure) continue;
+        Monster* m = NULL;
+        for (int e = store->first[r]; e < store->first[r + 1] && !m; e++) {
+            if (w->owner[id[e]]->hp > 0) m = w->owner[id[e]];
+        }
+        room->monster = m;
+        room->hasMonster = m != NULL;
+        room->events = roomEvents(room->hasMonster);
+    }
+}
+
+void wanderFree(Wander* w) {
+    for (int r = 0; r < w->store.numRooms; r++) w->rooms[r].monster = w->home[r];
+    free(w->chunk.counts);
+    free(w->owner);
+    free(w->home);
+    storeFree(&w->store);
+}
+
+void noiseInit(NoiseField* field, Room* rooms, int numRooms) {
+    field->rooms = rooms;
+    field->numRooms = numRooms;
+    field->words = (numRooms + 63) / 64;
+    field->level = malloc(sizeof(int) * numRooms);
+    field->stamp = malloc(sizeof(int) * numRooms);
+    field->seen = calloc(field->words, sizeof(uint64_t));
+    field->frontier = calloc(field->words, sizeof(uint64_t));
+    field->next = calloc(field->words, sizeof(uint64_t));
+    noiseReset(field);
+}
+
+void noiseReset(NoiseField* field) {
+    memset(field->level, 0, sizeof(int) * field->numRooms);
+    memset(field->stamp, 0, sizeof(int) * field->numRooms);
+    field->turn = 0;
+    field->emits = field->roomsReached = 0;
+}
+
+void noiseFree(NoiseField* field) {
+    free(field->level);
+    free(field->stamp);
+    free(field->seen);
+    free(field->frontier);
+    free(field->next);
+}
+
+int noiseLevel(const NoiseField* field, int room) {
+    int level = field->level[room] - (field->turn - field->stamp[room]);
+    return level > 0 ? level : 0;
+}
+
+// Breadth-first from room over the connections, one bitset per depth: a room at
+// distance d hears amount - d. Only the words the search reached are scanned and
+// cleared again. Returns how many rooms heard it.
+int noiseEmit(NoiseField* field, int room, int amount) {
+    uint64_t* seen = field->seen;
+    uint64_t* frontier = field->frontier;
+    uint64_t* next = field->next;
+    int lo = room >> 6, hi = room >> 6, first = lo, last = hi, heard = 0;
+    BIT_SET(seen, room);
+    BIT_SET(frontier, room);
+    for (int d = 0; d < amount; d++) {
+        int nextLo = field->words, nextHi = -1;
+        for (int w = lo; w <= hi; w++) {
+            uint64_t bits = frontier[w];
+            frontier[w] = 0;
+            while (bits) {
+                int r = (w << 6) + ctz64(bits);
+                bits &= bits - 1;
+                if (noiseLevel(field, r) < amount - d) {
+                    field->level[r] = amount - d;
+                    field->stamp[r] = field->turn;
+                }
+                if (d + 1 == amount) continue;
+                for (int k = 0; k < 4; k++) {
+                    Room* n = field->rooms[r].connections[k];
+                    if (!n || BIT_GET(seen, n->id)) continue;
+                    BIT_SET(seen, n->id);
+                    BIT_SET(next, n->id);
+                    if ((n->id >> 6) < nextLo) nextLo = n->id >> 6;
+                    if ((n->id >> 6) > nextHi) nextHi = n->id >> 6;
+                }
+            }
+        }
+        if (nextHi < 0) break;
+        uint64_t* swap = frontier;
+        frontier = next;
+        next = swap;
+        lo = nextLo;
+        hi = nextHi;
+        if (lo < first) first = lo;
+        if (hi > last) last = hi;
+    }
+    field->frontier = frontier;
+    field->next = next;
+
+    for (int w = first; w <= last; w++) {
+        heard += popcount64(seen[w]);
+        seen[w] = 0;
+        frontier[w] = 0;
+    }
+    field->emits++;
+    field->roomsReached += heard;
+    return heard;
+}
+
+// A move: earlier noise fades by one and the steps are heard around room
+void noiseMove(NoiseField* field, int room) {
+    field->turn++;
+    noiseEmit(field, room, NOISE_STEP);
+}